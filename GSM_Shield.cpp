@@ -72,11 +72,50 @@ void GSM::DebugPrint(int number_to_print, byte last_debug_print)
 }
 #endif
 
+// GSM(void) with the default comm buffer, reported by SQRL_RAM_REPORT
+// (SizedGSM<N> reports its own size)
+SQRL_REPORT_RAM(gsm, sizeof(GSM) + sizeof(AtCommsBuffer<COMM_BUF_LEN>))
+
+/**********************************************************
+  Comm buffer of GSM(void), it is allocated only when GSM(void)
+  is used so SizedGSM<N> takes no RAM for it
+
+  It is ONE buffer shared by all the GSM(void) objects - they
+  would share the received responses and the URC handler table
+  too, so only one GSM(void) object may exist. Use SizedGSM<N>
+  or GSM(AtComms &) for more modems.
+***********************************************************/
+static AtComms &DefaultComms(void)
+{
+  static AtCommsBuffer<COMM_BUF_LEN> comms;
+  return (comms);
+}
+
+// copies max. max_len characters and finishes the string
+static void CopyString(char *into, const char *from, byte max_len)
+{
+  strncpy(into, from, max_len);
+  into[max_len] = 0x00;
+}
+
 /**********************************************************
   Constructor definition
+
+  comms: AT communication with its comm buffer, see SizedGSM
+
+  GSM(void) uses the default comm buffer, there may be only
+  one such object (see DefaultComms())
 ***********************************************************/
 
-GSM::GSM(void) {
+GSM::GSM(void) : at(DefaultComms()), http(at) {
+  Init();
+}
+
+GSM::GSM(AtComms &comms) : at(comms), http(at) {
+  Init();
+}
+
+void GSM::Init(void) {
   // set some GSM pins as inputs, some as outputs
   //pinMode(GSM_ON, OUTPUT);               // sets pin 5 as output
   //pinMode(GSM_RESET, OUTPUT);            // sets pin 4 as output
@@ -90,6 +129,28 @@ GSM::GSM(void) {
 
   // initialization of speaker volume
   last_speaker_volume = 0; 
+
+  reg_lac = 0;
+  reg_cell_id = 0;
+
+  net_info.rssi = NET_RSSI_UNKNOWN;
+  net_info.ber = 99;
+  net_info.rssi_avg8 = 0;
+  net_info.oper[0] = 0x00;
+  net_info.lac = 0;
+  net_info.cell_id = 0;
+  net_info.sampled_at = 0;
+  net_sample_interval = NET_SAMPLE_INTERVAL;
+  net_polled_at = 0;
+  net_sample_count = 0;
+
+  gps_query_split = 0;
+  gps_query_errors = 0;
+  uart_mode = UART_UNKNOWN;
+  gps_power = GPS_POWER_UNKNOWN;
+  echo_off = 0;
+
+  at.AddUrcHandler(UrcHandler, this);
 }
 
 /**********************************************************
@@ -119,15 +180,12 @@ void GSM::InitSerLine()
         break;
     }
     delay(1000);
-    at.SendATCmdWaitResp(F("AT+IPR=9600"), 500, 50, F("OK"), 5);
+    at.SendATCmdWaitResp(ATC_IPR);
     delay(1000);
     Serial.begin(9600);
     delay(1000);
-    if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT"), 500, 100, F("OK"), 5)){
-#ifdef DEBUG_PRINT
-      Serial.print("DEBUG: Baud fixed via ");
-      Serial.println(i);
-#endif
+    if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_AT)){
+      SQRL_LOG_NUM(SQRL_LOG_INFO, SQRL_LOG_GEN, F("baud fixed via step"), i);
       break;
     }
   }
@@ -183,6 +241,7 @@ void GSM::ModeInit(void) {
 
   // GSM UART
   digitalWrite(3, LOW);
+  uart_mode = UART_GSM;
 
   delay(5000);
 
@@ -192,8 +251,18 @@ void GSM::ModeInit(void) {
   delay(5000);
 }
 
+/**********************************************************
+Method switches the serial line to the GSM UART
+- nothing is made if the GSM UART is already selected, so
+  the method can be called before every AT command
+- echo is turned off only once, the setting is kept by the
+  module while the GPS UART is selected
+- NMEA characters left from the GPS UART are discarded
+**********************************************************/
 void GSM::ModeGSM(void) {
 
+  if (uart_mode == UART_GSM) return;
+
   // UART OFF
   digitalWrite(3, HIGH);
   digitalWrite(4, HIGH);
@@ -202,14 +271,26 @@ void GSM::ModeGSM(void) {
 
   // GSM UART
   digitalWrite(3, LOW);
+  uart_mode = UART_GSM;
 
   delay(50);
 
-  Echo(0);
+  while (at.Port().available()) at.Port().read();
+
+  if (!echo_off) Echo(0);
 }
 
+/**********************************************************
+Method switches the serial line to the GPS UART
+- nothing is made if the GPS UART is already selected
+- there is no AT command interpreter on the GPS UART so 
+  echo is not changed, URCs of the GSM UART are lost 
+  while the GPS UART is selected
+**********************************************************/
 void GSM::ModeGPS(void) {
 
+  if (uart_mode == UART_GPS) return;
+
   // UART OFF
   digitalWrite(3, HIGH);
   digitalWrite(4, HIGH);
@@ -218,10 +299,9 @@ void GSM::ModeGPS(void) {
 
   // GPS UART
   digitalWrite(4, LOW);
+  uart_mode = UART_GPS;
 
   delay(50);
-
-  Echo(0);
 }
 
 /**********************************************************
@@ -235,49 +315,40 @@ void GSM::TurnOn(void)
   ModeInit();
 
   at.SetCommLineStatus(CLS_ATCMD);
-  if (AT_RESP_ERR_NO_RESP == at.SendATCmdWaitResp(F("AT"), 900, 200, F("OK"), 5)) {
+  if (AT_RESP_ERR_NO_RESP == at.SendATCmdWaitResp(ATC_AT)) {
     // there is no response => turn on the module
 
-#ifdef DEBUG_PRINT
-    Serial.println("DEBUG: GSM module is off");
-    Serial.println("DEBUG: start the module");
-#endif
+    SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("module is off, start it"));
 
     ModeInit();
   }
   else {
-#ifdef DEBUG_PRINT
-    Serial.println("DEBUG: GSM module is on");
-#endif
+    SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("module is on"));
   }
+  // the module may have been restarted, the GPS state is lost
+  gps_power = GPS_POWER_UNKNOWN;
+  gps_query_split = 0;
+  gps_query_errors = 0;
 
-  if (AT_RESP_ERR_DIF_RESP == at.SendATCmdWaitResp(F("AT"), 900, 200, F("OK"), 5)) {
+  if (AT_RESP_ERR_DIF_RESP == at.SendATCmdWaitResp(ATC_AT)) {
     //check OK
 
-#ifdef DEBUG_PRINT
-    Serial.println("DEBUG: the baud is not ok");
-#endif
+    SQRL_LOG(SQRL_LOG_WARN, SQRL_LOG_GEN, F("baud is not ok"));
 
     InitSerLine();
 
     // pointer is initialized to the first item of comm. buffer
     at.p_comm_buf = &at.comm_buf[0];
 
-    if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT"), 900, 200, F("OK"), 5)) {
-#ifdef DEBUG_PRINT
-      Serial.println("DEBUG: Baud now ok");
-#endif
+    if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_AT)) {
+      SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("baud now ok"));
     }
     else {
-#ifdef DEBUG_PRINT
-      Serial.println("DEBUG: Baud still bad");
-#endif
+      SQRL_LOG(SQRL_LOG_ERROR, SQRL_LOG_GEN, F("baud still bad"));
     }
   }
   else {
-#ifdef DEBUG_PRINT
-    Serial.println("DEBUG: 2 GSM module is on and baud is ok");
-#endif
+    SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("module is on and baud is ok"));
   }
 
   at.SetCommLineStatus(CLS_FREE);
@@ -294,7 +365,7 @@ void GSM::TurnOn(void)
 //delay(1000);
 
 byte GSM::Ready() {
-  if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT"), 200, 50, F("OK"), 2)) {
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_AT_PING)) {
     return GEN_SUCCESS;
   }
   else {
@@ -303,16 +374,17 @@ byte GSM::Ready() {
 }
 
 // eg 4564243333334414892F
+// id_string must have GSM_ICCID_LEN+1 characters
 byte GSM::GetICCID(char *id_string) {
   byte ret_code = GEN_FAILURE;
   id_string[0] = 0x00;
-  id_string[20] = 0x00;
+  id_string[GSM_ICCID_LEN] = 0x00;
 
   if (CLS_FREE != at.GetCommLineStatus()) return 0;
   at.SetCommLineStatus(CLS_ATCMD);
 
-  if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT+CCID"), 500, 50, F("OK"), 5)) {
-    at.ReadBuffer(id_string, 2, 20);
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_CCID)) {
+    at.ReadBuffer(id_string, 2, GSM_ICCID_LEN);
     ret_code = GEN_SUCCESS;
   }
 
@@ -334,18 +406,26 @@ void GSM::InitParam(byte group)
       if (CLS_FREE != at.GetCommLineStatus()) return;
       at.SetCommLineStatus(CLS_ATCMD);
 
-#ifdef DEBUG_PRINT
-      DebugPrint("DEBUG: configure the module PARAM_SET_0\r\n", 0);
-#endif
+      SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("configure PARAM_SET_0"));
 
       // Reset to the factory settings
-      at.SendATCmdWaitResp(F("AT&F"), 1000, 50, F("OK"), 5);
+      at.SendATCmdWaitResp(ATC_FACTORY);
+      gps_power = GPS_POWER_UNKNOWN;
+      gps_query_split = 0;
+      gps_query_errors = 0;
       // switch off echo
-      at.SendATCmdWaitResp(F("ATE0"), 500, 50, F("OK"), 5);
+      at.SendATCmdWaitResp(ATC_ECHO_OFF);
+      echo_off = 1;
       // setup fixed baud rate
-      at.SendATCmdWaitResp(F("AT+IPR=9600"), 500, 50, F("OK"), 5);
+      at.SendATCmdWaitResp(ATC_IPR);
       // turn off ip mode
-      at.SendATCmdWaitResp(F("AT+SAPBR=0,1"), 900, 100, F("OK"), 2);
+      at.SendATCmdWaitResp(ATC_SAPBR_CLOSE);
+      http.Invalidate();
+      // registration changes are reported by +CREG: <stat>,<lac>,<ci> URCs
+      at.SendATCmdWaitResp(ATC_CREG_LOC);
+      // no URC comes if the module is registered already, so the current
+      // state is read once - +CREG: <n>,<stat>,... goes to ParseRegistration()
+      at.SendATCmdWaitResp(ATC_CREG_QUERY);
       // setup mode
       //at.SendATCmdWaitResp("AT#SELINT=1", 500, 50, "OK", 5);
       // Switch ON User LED - just as signalization we are here
@@ -363,22 +443,20 @@ void GSM::InitParam(byte group)
       if (CLS_FREE != at.GetCommLineStatus()) return;
       at.SetCommLineStatus(CLS_ATCMD);
 
-#ifdef DEBUG_PRINT
-      DebugPrint("DEBUG: configure the module PARAM_SET_1\r\n", 0);
-#endif
+      SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("configure PARAM_SET_1"));
 
-      at.SendATCmdWaitResp(F("AT+CLIP=1"), 500, 50, F("OK"), 5); // Request calling line identification
-      at.SendATCmdWaitResp(F("AT+CRC=1"), 500, 50, F("OK"), 5); // Extended call indication +CRING
+      at.SendATCmdWaitResp(ATC_CLIP); // Request calling line identification
+      at.SendATCmdWaitResp(ATC_CRC); // Extended call indication +CRING
       //at.SendATCmdWaitResp("AT+CCLK=12/11/18,20:40:00", 500, 50, "OK", 5); // Set date and time
-      at.SendATCmdWaitResp(F("AT+CMEE=0"), 500, 50, F("OK"), 5); // Mobile Equipment Error Code
+      at.SendATCmdWaitResp(ATC_CMEE); // Mobile Equipment Error Code
       //at.SendATCmdWaitResp("AT#SHFEC=1", 500, 50, "OK", 5); // Echo canceller enabled 
       //at.SendATCmdWaitResp("AT#SRS=26,0", 500, 50, "OK", 5); // Ringer tone select (0 to 32)
       //at.SendATCmdWaitResp("AT#HFMICG=7", 1000, 50, "OK", 5); // Microphone gain (0 to 7) - response here sometimes takes more than 500msec. so 1000msec. is more safety
-      at.SendATCmdWaitResp(F("AT+CMGF=1"), 500, 50, F("OK"), 5); // set the SMS mode to text 
+      at.SendATCmdWaitResp(ATC_CMGF_TEXT); // set the SMS mode to text 
       //at.SendATCmdWaitResp("ATS0=1", 500, 50, "OK", 5); // Auto answer after first ring enabled
       //at.SendATCmdWaitResp("AT#SRP=1", 500, 50, "OK", 5); // select ringer path to handsfree
       //at.SendATCmdWaitResp("AT+CRSL=2", 500, 50, "OK", 5); // select ringer sound level
-      at.SendATCmdWaitResp(F("AT+CPBS=\"SM\""), 1000, 50, F("OK"), 5); // Set phonebook memory storage as SIM card
+      at.SendATCmdWaitResp(ATC_CPBS_SIM); // Set phonebook memory storage as SIM card
 
       at.SetCommLineStatus(CLS_FREE);
       //SetSpeakerVolume(9); // select speaker volume (0 to 14)
@@ -463,9 +541,11 @@ void GSM::SetSpeaker(byte off_on)
 Method checks if the GSM module is registered in the GSM net
 - this method communicates directly with the GSM module
   in contrast to the method IsRegistered() which reads the
-  flag from the module_status (this flag is set inside this method)
+  flag from the module_status
 
-- must be called regularly - from 1sec. to cca. 10 sec.
+- it is not necessary to call this method regularly,
+  registration state is updated from the +CREG URCs
+  (enabled by InitParam(PARAM_SET_0)) inside the Poll() method
 
 return values: 
       REG_NOT_REGISTERED  - not registered
@@ -481,43 +561,276 @@ byte GSM::CheckRegistration(void)
 
   if (CLS_FREE != at.GetCommLineStatus()) return (REG_COMM_LINE_BUSY);
   at.SetCommLineStatus(CLS_ATCMD);
-  Serial.println(F("AT+CREG?"));
+  at.Port().println(F("AT+CREG?"));
 
+  // +CREG: <n>,<stat>[,<lac>,<ci>] is parsed by the URC handler
+  at.UseTiming(ATT_CREG);
   status = at.WaitResp(5000, 200); 
 
   if (status == RX_FINISHED) {
-    if (at.IsStringReceived(F("+CREG: 0,1"))
-      || at.IsStringReceived(F("+CREG: 0,5"))) {
-      // it means module is registered
-      // ----------------------------
-      module_status |= STATUS_REGISTERED;
-
-      // in case GSM module is registered first time after reset
-      // sets flag STATUS_INITIALIZED
-      // it is used for sending some init commands which 
-      // must be sent only after registration
-      // --------------------------------------------
-      if (!IsInitialized()) {
-        module_status |= STATUS_INITIALIZED;
-        at.SetCommLineStatus(CLS_FREE);
-        InitParam(PARAM_SET_1);
-      }
-      ret_val = REG_REGISTERED;      
-    }
-    else {
+    if (!at.HasToken(AT_TOK_CREG)) {
       // NOT registered
       module_status &= ~STATUS_REGISTERED;
-      ret_val = REG_NOT_REGISTERED;
     }
+    if (IsRegistered()) ret_val = REG_REGISTERED;
+    else ret_val = REG_NOT_REGISTERED;
   }
   else {
     ret_val = REG_NO_RESPONSE;
   }
   at.SetCommLineStatus(CLS_FREE);
+
+  RunPendingInit();
  
   return (ret_val);
 }
 
+/**********************************************************
+Method services the comm line while it is not used
+- unsolicited result codes sent by the GSM module are read
+  and passed to the URC handlers
+- init commands postponed by the URC handler are sent
+- network info is sampled when the link is idle 
+  (see SetNetSampling())
+
+- must be called regularly - e.g. from the loop()
+**********************************************************/
+void GSM::Poll(void)
+{
+  if (CLS_FREE != at.GetCommLineStatus()) return;
+
+  if (at.Port().available()) {
+    at.SetCommLineStatus(CLS_ATCMD);
+    // URCs are dispatched inside WaitResp()
+    at.WaitResp(10, 50);
+    at.SetCommLineStatus(CLS_FREE);
+    // the link is not idle - sample next time
+    return;
+  }
+
+  RunPendingInit();
+  http.Service();
+
+  if (net_sample_interval
+      && (net_polled_at == 0
+          || (unsigned long)(millis() - net_polled_at) >= net_sample_interval)) {
+    SampleNetInfo();
+  }
+}
+
+/**********************************************************
+Method samples signal quality and (less often) operator name
+- responses are parsed by the URC handler so the snapshot is
+  also updated by +CSQ/+COPS responses requested elsewhere
+**********************************************************/
+void GSM::SampleNetInfo(void)
+{
+  if (CLS_FREE != at.GetCommLineStatus()) return;
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  // +CSQ: <rssi>,<ber>
+  at.SendATCmdWaitResp(ATC_CSQ);
+
+  if (net_sample_count % NET_OPER_EVERY == 0) {
+    // +COPS: <mode>,<format>,"<oper>"
+    at.SendATCmdWaitResp(ATC_COPS);
+  }
+  net_sample_count++;
+
+  // retry after the whole interval also in case of no response
+  net_polled_at = millis();
+  if (net_polled_at == 0) net_polled_at = 1;
+  net_info.lac = reg_lac;
+  net_info.cell_id = reg_cell_id;
+
+  at.SetCommLineStatus(CLS_FREE);
+}
+
+/**********************************************************
+Methods return rolling average of the signal quality
+
+GetSignalAvg() return: 
+        0..31 - average rssi
+        NET_RSSI_UNKNOWN - signal quality not known yet
+
+GetSignalDbm() return: 
+        -113..-51 - average signal strength in dBm
+        0 - signal quality not known yet
+**********************************************************/
+byte GSM::GetSignalAvg(void)
+{
+  if (net_info.sampled_at == 0) return (NET_RSSI_UNKNOWN);
+  return ((net_info.rssi_avg8 + 4) >> 3);
+}
+
+int GSM::GetSignalDbm(void)
+{
+  byte rssi = GetSignalAvg();
+
+  if (rssi == NET_RSSI_UNKNOWN) return (0);
+  return (-113 + 2 * (int)rssi);
+}
+
+/**********************************************************
+URC handler - called by AtComms for every received line
+**********************************************************/
+byte GSM::UrcHandler(void *context, byte token, const char *line, byte len)
+{
+  return ((GSM *)context)->HandleUrc(token, line, len);
+}
+
+byte GSM::HandleUrc(byte token, const char *line, byte len)
+{
+  switch (token) {
+    case AT_TOK_CREG:
+      if (len > 7) ParseRegistration(line + 7, len - 7);
+      return (len);
+    case AT_TOK_CSQ:
+      if (len > 6) ParseSignalQuality(line + 6, len - 6);
+      return (len);
+    case AT_TOK_COPS:
+      if (len > 7) ParseOperator(line + 7, len - 7);
+      return (len);
+  }
+  return (0);
+}
+
+/**********************************************************
+Method parses registration info
+
+unsolicited result code:      +CREG: <stat>[,"<lac>","<ci>"]
+response to the AT+CREG?:     +CREG: <n>,<stat>[,"<lac>","<ci>"]
+
+stat: 1 - registered, home network
+      5 - registered, roaming
+      other - not registered
+**********************************************************/
+void GSM::ParseRegistration(const char *p, byte len)
+{
+  const char *p_end = p + len;
+  byte stat = 0;
+  byte field = 0;
+  uint16_t value;
+  uint16_t hex[2] = {0, 0};
+  byte hex_count = 0;
+
+  while (p < p_end && *p != 0x0d && *p != 0x0a) {
+    if (*p >= '0' && *p <= '9' && field < 2) {
+      // <n> or <stat> - the last decimal field before "<lac>" is <stat>
+      stat = 0;
+      while (p < p_end && *p >= '0' && *p <= '9') {
+        stat = stat * 10 + (*p - '0');
+        p++;
+      }
+      field++;
+    }
+    else if (*p == '"' && hex_count < 2) {
+      // "<lac>" or "<ci>" in hexadecimal format
+      value = 0;
+      p++;
+      while (p < p_end && *p != '"') {
+        value <<= 4;
+        if (*p >= '0' && *p <= '9') value |= *p - '0';
+        else if (*p >= 'A' && *p <= 'F') value |= *p - 'A' + 10;
+        else if (*p >= 'a' && *p <= 'f') value |= *p - 'a' + 10;
+        p++;
+      }
+      hex[hex_count++] = value;
+      p++;
+    }
+    else p++;
+  }
+
+  if (hex_count == 2) {
+    reg_lac = hex[0];
+    reg_cell_id = hex[1];
+  }
+
+  if (stat == 1 || stat == 5) {
+    // it means module is registered
+    // ----------------------------
+    module_status |= STATUS_REGISTERED;
+
+    // in case GSM module is registered first time after reset
+    // sets flag STATUS_INITIALIZED
+    // it is used for sending some init commands which 
+    // must be sent only after registration
+    // the commands are sent later when the comm line is free
+    // --------------------------------------------
+    if (!IsInitialized()) {
+      module_status |= STATUS_INITIALIZED | STATUS_INIT_PENDING;
+    }
+  }
+  else {
+    // NOT registered
+    module_status &= ~STATUS_REGISTERED;
+  }
+}
+
+/**********************************************************
+Method parses signal quality 
++CSQ: <rssi>,<ber>
+
+rssi: 0..31 - -113..-51 dBm, 99 - not known
+ber:  0..7, 99 - not known
+
+rolling average of rssi is updated with the weight 1/8
+**********************************************************/
+void GSM::ParseSignalQuality(const char *p, byte len)
+{
+  const char *p_end = p + len;
+  byte rssi = 0;
+  byte ber = 0;
+
+  while (p < p_end && *p >= '0' && *p <= '9') rssi = rssi * 10 + (*p++ - '0');
+  if (p < p_end && *p == ',') p++;
+  while (p < p_end && *p >= '0' && *p <= '9') ber = ber * 10 + (*p++ - '0');
+
+  net_info.rssi = rssi;
+  net_info.ber = ber;
+  if (rssi > 31) return;
+
+  // rssi 0 (-113 dBm or less) is a valid sample, the average starts
+  // fresh only when there was no sample yet
+  if (net_info.sampled_at == 0) {
+    net_info.rssi_avg8 = (uint16_t)rssi << 3;
+  }
+  else {
+    net_info.rssi_avg8 = net_info.rssi_avg8 - (net_info.rssi_avg8 >> 3) + rssi;
+  }
+  net_info.sampled_at = millis();
+  if (net_info.sampled_at == 0) net_info.sampled_at = 1;
+}
+
+/**********************************************************
+Method parses operator name
++COPS: <mode>[,<format>,"<oper>"]
+**********************************************************/
+void GSM::ParseOperator(const char *p, byte len)
+{
+  const char *p_end = p + len;
+  byte i = 0;
+
+  while (p < p_end && *p != '"' && *p != 0x0d) p++;
+  if (p < p_end && *p == '"') {
+    p++;
+    while (p < p_end && *p != '"' && i < NET_OPER_LEN) net_info.oper[i++] = *p++;
+  }
+  net_info.oper[i] = 0x00;
+}
+
+/**********************************************************
+Method sends init commands postponed after the first registration
+**********************************************************/
+void GSM::RunPendingInit(void)
+{
+  if (!(module_status & STATUS_INIT_PENDING)) return;
+  if (CLS_FREE != at.GetCommLineStatus()) return;
+
+  module_status &= ~STATUS_INIT_PENDING;
+  InitParam(PARAM_SET_1);
+}
+
 /**********************************************************
 Method checks status of call
 
@@ -531,23 +844,22 @@ return:
 byte GSM::CallStatus(void)
 {
   byte ret_val = CALL_NONE;
+  char *p_char;
 
   if (CLS_FREE != at.GetCommLineStatus()) return (CALL_COMM_LINE_BUSY);
   at.SetCommLineStatus(CLS_ATCMD);
-  Serial.println(F("AT+CPAS"));
+  at.Port().println(F("AT+CPAS"));
 
+  at.UseTiming(ATT_CPAS);
   if (RX_TMOUT_ERR == at.WaitResp(5000, 200)) {
     ret_val = CALL_NO_RESPONSE;
   }
-  else {
-    if (at.IsStringReceived(F("+CPAS: 0"))) {
-      ret_val = CALL_NONE;
-    }
-    else if (at.IsStringReceived(F("+CPAS: 3"))) {
-      ret_val = CALL_INCOM_VOICE;
-    }
-    else if (at.IsStringReceived(F("+CPAS: 4"))) {
-      ret_val = CALL_ACTIVE_VOICE;
+  else if ((p_char = at.FindToken(AT_TOK_CPAS)) != NULL) {
+    // +CPAS: <pas>
+    switch (p_char[7]) {
+      case '0': ret_val = CALL_NONE; break;
+      case '3': ret_val = CALL_INCOM_VOICE; break;
+      case '4': ret_val = CALL_ACTIVE_VOICE; break;
     }
   }
 
@@ -595,6 +907,7 @@ byte GSM::CallStatusWithAuth(char *phone_number, byte &fav,
   byte i;
   char *p_char; 
   char *p_char1;
+  char *clcc;
 
   phone_number[0] = 0x00;  // no phonr number so far
   if (CLS_FREE != at.GetCommLineStatus()) return (CALL_COMM_LINE_BUSY);
@@ -604,66 +917,71 @@ byte GSM::CallStatusWithAuth(char *phone_number, byte &fav,
   // generate tmout 30msec. before next AT command
   /* delay(30); */
 
-  if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT+CLCC"), 5000, 1500, F("OK\r\n"), 1)) {
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_CLCC)) {
     // something was received but what was received?
     // example: //+CLCC: 1,1,4,0,0,"+420XXXXXXXXX",145
     // ---------------------------------------------
-    if(at.IsStringReceived(F("+CLCC: 1,1,4,0,0"))) { 
+    // the +CLCC line is found once, then only <id>,<dir>,<stat>,<mode>,<mpty>
+    // at its fixed position are compared
+    p_char = at.FindToken(AT_TOK_CLCC);
+    clcc = (p_char != NULL) ? p_char + 7 : NULL;
+
+    if (clcc == NULL) {
+      // only "OK" => there is NO call activity
+      // --------------------------------------
+      if (at.HasToken(AT_TOK_OK)) ret_val = CALL_NONE;
+    }
+    else if (strncmp_P(clcc, PSTR("1,1,4,0,0"), 9) == 0) { 
       // incoming VOICE call - not authorized so far
       // -------------------------------------------
       search_phone_num = 1;
       ret_val = CALL_INCOM_VOICE_NOT_AUTH;
     }
-    else if(at.IsStringReceived(F("+CLCC: 1,1,4,1,0"))) {
+    else if (strncmp_P(clcc, PSTR("1,1,4,1,0"), 9) == 0) {
       // incoming DATA call - not authorized so far
       search_phone_num = 1;
       ret_val = CALL_INCOM_DATA_NOT_AUTH;
     }
-    else if (at.IsStringReceived(F("+CLCC: 1,0,2,0,0")) || 
-             at.IsStringReceived(F("+CLCC: 1,0,3,0,0"))) { 
+    else if (strncmp_P(clcc, PSTR("1,0,2,0,0"), 9) == 0 || 
+             strncmp_P(clcc, PSTR("1,0,3,0,0"), 9) == 0) { 
       // dialing (2) or alerting (3) VOICE call - GSM is caller
       search_phone_num = 0;
       ret_val = CALL_OUT_VOICE;
     }
-    else if(at.IsStringReceived(F("+CLCC: 1,0,0,0,0"))) { 
+    else if (strncmp_P(clcc, PSTR("1,0,0,0,0"), 9) == 0) { 
       // active VOICE call - GSM is caller
       search_phone_num = 1;
       ret_val = CALL_ACTIVE_VOICE;
     }
-    else if(at.IsStringReceived(F("+CLCC: 1,1,0,0,0"))) { 
+    else if (strncmp_P(clcc, PSTR("1,1,0,0,0"), 9) == 0) { 
       // active VOICE call - GSM is listener
       search_phone_num = 1;
       ret_val = CALL_ACTIVE_VOICE;
     }
-    else if(at.IsStringReceived(F("+CLCC: 1,1,0,1,0"))) { 
+    else if (strncmp_P(clcc, PSTR("1,1,0,1,0"), 9) == 0) { 
       // active DATA call - GSM is listener
       // ----------------------------------
       search_phone_num = 1;
       ret_val = CALL_ACTIVE_DATA;
     }
-    else if(at.IsStringReceived(F("+CLCC:"))){ 
+    else { 
       // other string is not important for us - e.g. GSM module activate call
       // etc.
       // IMPORTANT - each +CLCC:xx response has also at the end
       // string <CR><LF>OK<CR><LF>
       ret_val = CALL_OTHERS;
     }
-    else if(at.IsStringReceived(F("OK"))){ 
-      // only "OK" => there is NO call activity
-      // --------------------------------------
-      ret_val = CALL_NONE;
-    }
 
     // now we will search phone num string
     if (search_phone_num) {
       // extract phone number string
       // ---------------------------
-      p_char = strchr((char *)(at.comm_buf),'"');
+      p_char = strchr(clcc,'"');
       p_char1 = p_char+1; // we are on the first phone number character
       p_char = strchr((char *)(p_char1),'"');
       if (p_char != NULL) {
         *p_char = 0; // end of string
-        strcpy(phone_number, (char *)(p_char1));
+        CopyString(phone_number, p_char1, GSM_PHONE_NUM_LEN);
       }
 
       if ( (ret_val == CALL_INCOM_VOICE_NOT_AUTH) 
@@ -711,7 +1029,7 @@ void GSM::PickUp(void)
 {
   if (CLS_FREE != at.GetCommLineStatus()) return;
   at.SetCommLineStatus(CLS_ATCMD);
-  at.SendATCmdWaitResp(F("ATA"), 1000, 100, F("OK"), 2);
+  at.SendATCmdWaitResp(ATC_ANSWER);
   at.SetCommLineStatus(CLS_FREE);
 }
 
@@ -724,7 +1042,7 @@ void GSM::HangUp(void)
 {
   if (CLS_FREE != at.GetCommLineStatus()) return;
   at.SetCommLineStatus(CLS_ATCMD);
-  at.SendATCmdWaitResp(F("ATH"), 1000, 100, F("OK"), 2);
+  at.SendATCmdWaitResp(ATC_HANGUP);
   at.SetCommLineStatus(CLS_FREE);
 }
 
@@ -740,9 +1058,9 @@ void GSM::Call(char *number_string)
   if (CLS_FREE != at.GetCommLineStatus()) return;
   at.SetCommLineStatus(CLS_ATCMD);
   // ATDxxxxxx;<CR>
-  Serial.print(F("ATD"));
-  Serial.print(number_string);
-  Serial.println(F(";"));
+  at.Port().print(F("ATD"));
+  at.Port().print(number_string);
+  at.Port().println(F(";"));
   at.WaitResp(10000, 200);
   at.SetCommLineStatus(CLS_FREE);
 }
@@ -758,9 +1076,9 @@ void GSM::Call(int sim_position)
   if (CLS_FREE != at.GetCommLineStatus()) return;
   at.SetCommLineStatus(CLS_ATCMD);
   // ATD>"SM" 1;<CR>
-  Serial.print(F("ATD>\"SM\" "));
-  Serial.print(sim_position);
-  Serial.println(F(";"));
+  at.Port().print(F("ATD>\"SM\" "));
+  at.Port().print(sim_position);
+  at.Port().println(F(";"));
   at.WaitResp(10000, 200);
   at.SetCommLineStatus(CLS_FREE);
 }
@@ -792,16 +1110,16 @@ char GSM::SetSpeakerVolume(byte speaker_volume)
   if (speaker_volume > 14) speaker_volume = 14;
   // select speaker volume (0 to 14)
   // AT+CLVL=X<CR>   X<0..14>
-  Serial.print(F("AT+CLVL="));
-  Serial.print((int)speaker_volume);    
-  Serial.print('\r'); // send <CR>
+  at.Port().print(F("AT+CLVL="));
+  at.Port().print((int)speaker_volume);    
+  at.Port().print('\r'); // send <CR>
   // 10 sec. for initial comm tmout
   // 50 msec. for inter character timeout
   if (RX_TMOUT_ERR == at.WaitResp(10000, 50)) {
     ret_val = -2; // ERROR
   }
   else {
-    if(at.IsStringReceived(F("OK"))) {
+    if (at.HasToken(AT_TOK_OK)) {
       last_speaker_volume = speaker_volume;
       ret_val = last_speaker_volume; // OK
     }
@@ -895,16 +1213,16 @@ char GSM::SendDTMFSignal(byte dtmf_tone)
   if (CLS_FREE != at.GetCommLineStatus()) return (ret_val);
   at.SetCommLineStatus(CLS_ATCMD);
   // e.g. AT+VTS=5<CR>
-  Serial.print(F("AT+VTS="));
-  Serial.print((int)dtmf_tone);    
-  Serial.print('\r');
+  at.Port().print(F("AT+VTS="));
+  at.Port().print((int)dtmf_tone);    
+  at.Port().print('\r');
   // 1 sec. for initial comm tmout
   // 50 msec. for inter character timeout
   if (RX_TMOUT_ERR == at.WaitResp(1000, 50)) {
     ret_val = -2; // ERROR
   }
   else {
-    if(at.IsStringReceived(F("OK"))) {
+    if (at.HasToken(AT_TOK_OK)) {
       ret_val = dtmf_tone; // OK
     }
     else ret_val = -3; // ERROR
@@ -972,30 +1290,29 @@ char GSM::SendSMS(const __FlashStringHelper *number_str, char *message_str)
   // try to send SMS 3 times in case there is some problem
   for (i = 0; i < 3; i++) {
     // send  AT+CMGS="number_str"
-    Serial.print(F("AT+CMGS=\""));
-    Serial.print(number_str);  
-    Serial.print(F("\"\r"));
+    at.Port().print(F("AT+CMGS=\""));
+    at.Port().print(number_str);  
+    at.Port().print(F("\"\r"));
 
     // 1000 msec. for initial comm tmout
     // 50 msec. for inter character timeout
     if (RX_FINISHED_STR_RECV == at.WaitResp(1000, 50, F(">"))) {
       // send SMS text
-      Serial.print(message_str); 
+      at.Port().print(message_str); 
 	  
 #ifdef DEBUG_SMS_ENABLED
       // SMS will not be sent = we will not pay => good for debugging
-      Serial.write(0x1b);
+      at.Port().write(0x1b);
       if (RX_FINISHED_STR_RECV == at.WaitResp(7000, 50, F("OK"))) { /* } */
 #else 
-      Serial.write(0x1a);
+      at.Port().write(0x1a);
 	  //Serial.flush(); // erase rx circular buffer
+      at.UseTiming(ATT_CMGS);
       if (RX_FINISHED_STR_RECV == at.WaitResp(7000, 5000, F("+CMGS"))) {
 #endif
         // SMS was send correctly 
         ret_val = 1;
-		#ifdef DEBUG_PRINT
-			DebugPrint("SMS was send correctly \r\n", 0);
-		#endif
+        SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("SMS was sent"));
         break;
       }
       else continue;
@@ -1021,30 +1338,29 @@ char GSM::SendSMS(char *number_str, char *message_str)
   // try to send SMS 3 times in case there is some problem
   for (i = 0; i < 3; i++) {
     // send  AT+CMGS="number_str"
-    Serial.print(F("AT+CMGS=\""));
-    Serial.print(number_str);  
-    Serial.print(F("\"\r"));
+    at.Port().print(F("AT+CMGS=\""));
+    at.Port().print(number_str);  
+    at.Port().print(F("\"\r"));
 
     // 1000 msec. for initial comm tmout
     // 50 msec. for inter character timeout
     if (RX_FINISHED_STR_RECV == at.WaitResp(1000, 50, F(">"))) {
       // send SMS text
-      Serial.print(message_str); 
+      at.Port().print(message_str); 
 	  
 #ifdef DEBUG_SMS_ENABLED
       // SMS will not be sent = we will not pay => good for debugging
-      Serial.write(0x1b);
+      at.Port().write(0x1b);
       if (RX_FINISHED_STR_RECV == at.WaitResp(7000, 50, F("OK"))) { /* } */
 #else 
-      Serial.write(0x1a);
+      at.Port().write(0x1a);
 	  //Serial.flush(); // erase rx circular buffer
+      at.UseTiming(ATT_CMGS);
       if (RX_FINISHED_STR_RECV == at.WaitResp(7000, 5000, F("+CMGS"))) {
 #endif
         // SMS was send correctly 
         ret_val = 1;
-		#ifdef DEBUG_PRINT
-			DebugPrint("SMS was send correctly \r\n", 0);
-		#endif
+        SQRL_LOG(SQRL_LOG_INFO, SQRL_LOG_GEN, F("SMS was sent"));
         break;
       }
       else continue;
@@ -1086,7 +1402,7 @@ an example of usage:
 char GSM::SendSMS(byte sim_phonebook_position, char *message_str) 
 {
   char ret_val = -1;
-  char sim_phone_number[20];
+  char sim_phone_number[GSM_PHONE_NUM_LEN+1];
 
   ret_val = 0; // SMS is not send yet
   if (sim_phonebook_position == 0) return (-3);
@@ -1127,13 +1443,13 @@ char GSM::InitSMSMemory(void)
   ret_val = 0; // not initialized yet
   
   // Disable messages about new SMS from the GSM module 
-  at.SendATCmdWaitResp(F("AT+CNMI=2,0"), 1000, 50, F("OK"), 2);
+  at.SendATCmdWaitResp(ATC_CNMI);
 
   // send AT command to init memory for SMS in the SIM card
   // response:
   // +CPMS: <usedr>,<totalr>,<usedw>,<totalw>,<useds>,<totals>
   // Changed to two SM s only - TJH
-  if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT+CPMS=\"SM\",\"SM\""), 1000, 1000, F("+CPMS:"), 10)) {
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_CPMS_SIM)) {
     ret_val = 1;
   }
   else ret_val = 0;
@@ -1172,7 +1488,7 @@ return:
 an example of use:
         GSM gsm;
         char position;  
-        char phone_number[20]; // array for the phone number string
+        char phone_number[GSM_PHONE_NUM_LEN+1]; // array for the phone number string
         char sms_text[100];
 
         position = gsm.IsSMSPresent(SMS_UNREAD);
@@ -1195,16 +1511,17 @@ char GSM::IsSMSPresent(byte required_status)
 
   switch (required_status) {
     case SMS_UNREAD:
-      Serial.print(F("AT+CMGL=\"REC UNREAD\"\r"));
+      at.Port().print(F("AT+CMGL=\"REC UNREAD\"\r"));
       break;
     case SMS_READ:
-      Serial.print(F("AT+CMGL=\"REC READ\"\r"));
+      at.Port().print(F("AT+CMGL=\"REC READ\"\r"));
       break;
     case SMS_ALL:
-      Serial.print(F("AT+CMGL=\"ALL\"\r"));
+      at.Port().print(F("AT+CMGL=\"ALL\"\r"));
       break;
   }
 
+  at.UseTiming(ATT_CMGL);
   if (RX_FINISHED_STR_RECV == at.WaitResp(5000, 1500, F("OK"))) {
 
     // there is either NO SMS:
@@ -1214,12 +1531,12 @@ char GSM::IsSMSPresent(byte required_status)
     // +CMGL: <index>,<stat>,<oa/da>,,[,<tooa/toda>,<length>]
     // <CR><LF> <data> <CR><LF>OK<CR><LF>
 
-    if (at.IsStringReceived(F("+CMGL:"))) {
+    if ((p_char = at.FindToken(AT_TOK_CMGL)) != NULL) {
       // there is some SMS with status => get its position
       // response is:
       // +CMGL: <index>,<stat>,<oa/da>,,[,<tooa/toda>,<length>]
       // <CR><LF> <data> <CR><LF>OK<CR><LF>
-      p_char = strchr((char *)at.comm_buf,':');
+      p_char = strchr(p_char,':');
       if (p_char != NULL) {
         ret_val = atoi(p_char+1);
       }
@@ -1265,7 +1582,7 @@ return:
 an example of usage:
         GSM gsm;
         char position;
-        char phone_num[20]; // array for the phone number string
+        char phone_num[GSM_PHONE_NUM_LEN+1]; // array for the phone number string
         char sms_text[100]; // array for the SMS text string
 
         position = gsm.IsSMSPresent(SMS_UNREAD);
@@ -1285,7 +1602,9 @@ char GSM::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS
   char ret_val = -1;
   char *p_char; 
   char *p_char1;
+  char *p_cmgr = NULL;
   byte len;
+  byte status;
 
   if (position == 0) return (-3);
   if (CLS_FREE != at.GetCommLineStatus()) return (ret_val);
@@ -1294,13 +1613,20 @@ char GSM::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS
   ret_val = GETSMS_NO_SMS; // still no SMS
   
   //send "AT+CMGR=X" - where X = position
-  Serial.print(F("AT+CMGR="));
-  Serial.print((int)position);  
-  Serial.print('\r');
+  at.Port().print(F("AT+CMGR="));
+  at.Port().print((int)position);  
+  at.Port().print('\r');
 
   // 5000 msec. for initial comm tmout
   // 100 msec. for inter character tmout
-  switch (at.WaitResp(5000, 100, F("+CMGR"))) {
+  at.UseTiming(ATT_CMGR);
+  status = at.WaitResp(5000, 100);
+  if (status == RX_FINISHED) {
+    p_cmgr = at.FindToken(AT_TOK_CMGR);
+    status = (p_cmgr != NULL) ? RX_FINISHED_STR_RECV : RX_FINISHED_STR_NOT_RECV;
+  }
+
+  switch (status) {
     case RX_TMOUT_ERR:
       // response was not received in specific time
       ret_val = -2;
@@ -1308,12 +1634,12 @@ char GSM::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS
 
     case RX_FINISHED_STR_NOT_RECV:
       // OK was received => there is NO SMS stored in this position
-      if(at.IsStringReceived(F("OK"))) {
+      if (at.HasToken(AT_TOK_OK)) {
         // there is only response <CR><LF>OK<CR><LF> 
         // => there is NO SMS
         ret_val = GETSMS_NO_SMS;
       }
-      else if(at.IsStringReceived(F("ERROR"))) {
+      else if (at.HasToken(AT_TOK_ERROR)) {
         // error should not be here but for sure
         ret_val = GETSMS_NO_SMS;
       }
@@ -1325,7 +1651,7 @@ char GSM::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS
       //response for new SMS:
       //<CR><LF>+CMGR: "REC UNREAD","+XXXXXXXXXXXX",,"02/03/18,09:54:28+40"<CR><LF>
 		  //There is SMS text<CR><LF>OK<CR><LF>
-      if(at.IsStringReceived(F("\"REC UNREAD\""))) { 
+      if (strncmp_P(p_cmgr + 7, PSTR("\"REC UNREAD\""), 12) == 0) { 
         // get phone number of received SMS: parse phone number string 
         // +XXXXXXXXXXXX
         // -------------------------------------------------------
@@ -1334,7 +1660,7 @@ char GSM::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS
       //response for already read SMS = old SMS:
       //<CR><LF>+CMGR: "REC READ","+XXXXXXXXXXXX",,"02/03/18,09:54:28+40"<CR><LF>
 		  //There is SMS text<CR><LF>
-      else if(at.IsStringReceived(F("\"REC READ\""))) {
+      else if (strncmp_P(p_cmgr + 7, PSTR("\"REC READ\""), 10) == 0) {
         // get phone number of received SMS
         // --------------------------------
         ret_val = GETSMS_READ_SMS;
@@ -1346,12 +1672,12 @@ char GSM::GetSMS(byte position, char *phone_number, char *SMS_text, byte max_SMS
 
       // extract phone number string
       // ---------------------------
-      p_char = strchr((char *)(at.comm_buf),',');
+      p_char = strchr(p_cmgr,',');
       p_char1 = p_char+2; // we are on the first phone number character
       p_char = strchr((char *)(p_char1),'"');
       if (p_char != NULL) {
         *p_char = 0; // end of string
-        strcpy(phone_number, (char *)(p_char1));
+        CopyString(phone_number, p_char1, GSM_PHONE_NUM_LEN);
       }
 
 
@@ -1440,7 +1766,7 @@ return:
 
 an example of usage:
         GSM gsm;
-        char phone_num[20]; // array for the phone number string
+        char phone_num[GSM_PHONE_NUM_LEN+1]; // array for the phone number string
         char sms_text[100]; // array for the SMS text string
 
         // authorize SMS with SIM phonebook positions 1..3
@@ -1473,15 +1799,9 @@ char GSM::GetAuthorizedSMS(byte position, char *phone_number, char *SMS_text, by
   char ret_val = -1;
   byte i;
 
-#ifdef DEBUG_PRINT
-    DebugPrint("DEBUG GetAuthorizedSMS\r\n", 0);
-    DebugPrint("      #1: ", 0);
-    DebugPrint(position, 0);
-    DebugPrint("      #5: ", 0);
-    DebugPrint(first_authorized_pos, 0);
-    DebugPrint("      #6: ", 0);
-    DebugPrint(last_authorized_pos, 1);
-#endif  
+  SQRL_LOG_NUM(SQRL_LOG_DEBUG, SQRL_LOG_GEN, F("GetAuthorizedSMS position"), position);
+  SQRL_LOG_NUM(SQRL_LOG_DEBUG, SQRL_LOG_GEN, F("  first authorized"), first_authorized_pos);
+  SQRL_LOG_NUM(SQRL_LOG_DEBUG, SQRL_LOG_GEN, F("  last authorized"), last_authorized_pos);
 
   ret_val = GetSMS(position, phone_number, SMS_text, max_SMS_len);
   if (ret_val < 0) {
@@ -1548,9 +1868,9 @@ char GSM::DeleteSMS(byte position)
   ret_val = 0; // not deleted yet
   
   //send "AT+CMGD=XY" - where XY = position
-  Serial.print(F("AT+CMGD="));
-  Serial.print((int)position);  
-  Serial.print('\r');
+  at.Port().print(F("AT+CMGD="));
+  at.Port().print((int)position);  
+  at.Port().print('\r');
 
 
   // 5000 msec. for initial comm tmout
@@ -1600,7 +1920,7 @@ return:
 
 an example of usage:
         GSM gsm;
-        char phone_num[20]; // array for the phone number string
+        char phone_num[GSM_PHONE_NUM_LEN+1]; // array for the phone number string
 
         if (1 == gsm.GetPhoneNumber(1, phone_num)) {
           // valid phone number on SIM pos. #1 
@@ -1631,12 +1951,13 @@ char GSM::GetPhoneNumber(byte position, char *phone_number)
   phone_number[0] = 0; // phone number not found yet => empty string
   
   //send "AT+CPBR=XY" - where XY = position
-  Serial.print(F("AT+CPBR="));
-  Serial.print((int)position);  
-  Serial.print('\r');
+  at.Port().print(F("AT+CPBR="));
+  at.Port().print((int)position);  
+  at.Port().print('\r');
 
   // 5000 msec. for initial comm tmout
   // 50 msec. for inter character timeout
+  at.UseTiming(ATT_CPBR);
   switch (at.WaitResp(5000, 50, F("+CPBR"))) {
     case RX_TMOUT_ERR:
       // response was not received in specific time
@@ -1659,7 +1980,7 @@ char GSM::GetPhoneNumber(byte position, char *phone_number)
           *p_char1 = 0; // end of string
         }
         // extract phone number string
-        strcpy(phone_number, (char *)(p_char));
+        CopyString(phone_number, p_char, GSM_PHONE_NUM_LEN);
         // output value = we have found out phone number string
         ret_val = 1;
       }
@@ -1705,11 +2026,11 @@ char GSM::WritePhoneNumber(byte position, char *phone_number)
   //send: AT+CPBW=XY,"00420123456789"
   // where XY = position,
   //       "00420123456789" = phone number string
-  Serial.print(F("AT+CPBW="));
-  Serial.print((int)position);
-  Serial.print(F(",\""));
-  Serial.print(phone_number);
-  Serial.println(F("\""));
+  at.Port().print(F("AT+CPBW="));
+  at.Port().print((int)position);
+  at.Port().print(F(",\""));
+  at.Port().print(phone_number);
+  at.Port().println(F("\""));
 
   switch (at.WaitResp(5000, 50, F("OK"))) {
     case RX_FINISHED_STR_RECV: // response is OK = has been written
@@ -1723,15 +2044,7 @@ char GSM::WritePhoneNumber(byte position, char *phone_number)
 
   at.SetCommLineStatus(CLS_FREE);
 
-#ifdef DEBUG_PRINT
-  if (ret_val == 1) {
-    Serial.println("DEBUG: Write phone number success");
-  }
-  else {
-    Serial.print("DEBUG: Write phone number failed with ");
-    Serial.println(ret_val);
-  }
-#endif
+  SQRL_LOG_NUM(SQRL_LOG_INFO, SQRL_LOG_GEN, F("write phone number result"), ret_val);
 
   return (ret_val);
 }
@@ -1765,9 +2078,9 @@ char GSM::DelPhoneNumber(byte position)
   
   //send: AT+CPBW=XY
   // where XY = position
-  Serial.print(F("AT+CPBW="));
-  Serial.print((int)position);  
-  Serial.print('\r');
+  at.Port().print(F("AT+CPBW="));
+  at.Port().print((int)position);  
+  at.Port().print('\r');
 
   // 5000 msec. for initial comm tmout
   // 50 msec. for inter character timeout
@@ -1831,15 +2144,9 @@ an example of usage:
 char GSM::ComparePhoneNumber(byte position, char *phone_number)
 {
   char ret_val = -1;
-  char sim_phone_number[20];
+  char sim_phone_number[GSM_PHONE_NUM_LEN+1];
 
-#ifdef DEBUG_PRINT
-    DebugPrint("DEBUG ComparePhoneNumber\r\n", 0);
-    DebugPrint("      #1: ", 0);
-    DebugPrint(position, 0);
-    DebugPrint("      #2: ", 0);
-    DebugPrint(phone_number, 1);
-#endif
+  SQRL_LOG_NUM(SQRL_LOG_DEBUG, SQRL_LOG_GEN, F("ComparePhoneNumber position"), position);
 
 
   ret_val = 0; // numbers are not the same so far
@@ -1850,9 +2157,7 @@ char GSM::ComparePhoneNumber(byte position, char *phone_number)
     if (0 == strcmp(phone_number, sim_phone_number)) {
       // phone numbers are the same
       // --------------------------
-#ifdef DEBUG_PRINT
-    DebugPrint("DEBUG ComparePhoneNumber: Phone numbers are the same", 1);
-#endif
+      SQRL_LOG(SQRL_LOG_DEBUG, SQRL_LOG_GEN, F("phone numbers are the same"));
       ret_val = 1;
     }
   }
@@ -1899,10 +2204,11 @@ char GSM::GetDateTime(char *date_time)
   ret_val = GETSMS_NO_SMS; // still no SMS
   
   //send "AT+CCLK?" to request date and time
-  Serial.print(F("AT+CCLK?\r")); 
+  at.Port().print(F("AT+CCLK?\r")); 
 
   // 5000 msec. for initial comm tmout
   // 100 msec. for inter character tmout
+  at.UseTiming(ATT_CCLK);
   switch (at.WaitResp(5000, 100, F("+CCLK"))) {
     case RX_TMOUT_ERR:
       // response was not received in specific time
@@ -1911,12 +2217,12 @@ char GSM::GetDateTime(char *date_time)
 
     case RX_FINISHED_STR_NOT_RECV:
       // OK was received => there is NO SMS stored in this position
-      if(at.IsStringReceived(F("OK"))) {
+      if (at.HasToken(AT_TOK_OK)) {
         // there is only response <CR><LF>OK<CR><LF> 
         // => there is NO SMS
         ret_val = GETSMS_NO_SMS;
       }
-      else if(at.IsStringReceived(F("ERROR"))) {
+      else if (at.HasToken(AT_TOK_ERROR)) {
         // error should not be here but for sure
         ret_val = GETSMS_NO_SMS;
       }
@@ -1930,7 +2236,7 @@ char GSM::GetDateTime(char *date_time)
       p_char = strchr((char *)(p_char1),'"');
       if (p_char != NULL) {
         *p_char = 0; // end of string
-        strcpy(date_time, (char *)(p_char1));
+        CopyString(date_time, p_char1, GSM_DATE_TIME_LEN);
       }
       break;
   }
@@ -1948,100 +2254,42 @@ void GSM::Echo(byte state)
 {
   if (state == 0 or state == 1) {
     at.SetCommLineStatus(CLS_ATCMD);
-    Serial.print(F("ATE"));
-    Serial.print((int)state);
-    Serial.println();
+    at.Port().print(F("ATE"));
+    at.Port().print((int)state);
+    at.Port().println();
     delay(500);
     at.SetCommLineStatus(CLS_FREE);
+    echo_off = (state == 0);
   }
 }
 
 void GSM::SetupGPRS() {
   // 2 degrees APN is internet, no user, no password
-  at.SendATCmdWaitResp(F("AT+SAPBR=3,1,\"APN\",\"internet\""), 900, 500, F("OK"), 2);
+  at.SendATCmdWaitResp(ATC_SAPBR_APN);
   /* at.SendATCmdWaitResp(F("AT+SAPBR=3,1,\"USER\",\"yourUser\""), 900, 500, F("OK"), 2); */
   /* at.SendATCmdWaitResp(F("AT+SAPBR=3,1,\"PWD\",\"yourPwd\""), 900, 500, F("OK"), 2); */
-  at.SendATCmdWaitResp(F("AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\""), 900, 500, F("OK"), 2);
+  at.SendATCmdWaitResp(ATC_SAPBR_GPRS);
 }
 
 
 byte GSM::HttpGet(const char *url, char *result) {
-  return HttpOperation(F("AT+HTTPACTION=0"), F("+HTTPACTION:0,200"), url, result);
+  return http.Action(HTTP_METHOD_GET, url, result);
 }
 
-byte GSM::HttpPost(const char *urlp, char *result) {
-  return HttpOperation(F("AT+HTTPACTION=1"), F("+HTTPACTION:1,200"), urlp, result);
-}
-
-byte GSM::HttpOperation(const __FlashStringHelper *op, const __FlashStringHelper *respcode, const char *url, char *result) {
-  result[0] = 0x00;
-  byte res_code = HTTP_FAIL;
-
-  // check if registered?!
-  at.SendATCmdWaitResp(F("AT+SAPBR=2,1"), 900, 900, F("OK"), 5); // query bearer
-  //+SAPBR: 1,3,"0.0.0.0" --> closed
-  //+SAPBR: 1,1,"100.70.120.92" --> open
-  if (!at.IsStringReceived(F("+SAPBR: 1,1"))) {
-    at.SendATCmdWaitResp(F("AT+SAPBR=1,1"), 20000, 900, F("OK"), 5); // open bearer
-  }
-
-  at.SendATCmdWaitResp(F("AT+SAPBR=2,1"), 900, 900, F("OK"), 5); // query bearer
-  if (at.IsStringReceived(F("+SAPBR: 1,1"))) {
-
-      at.SendATCmdWaitResp(F("AT+HTTPINIT"), 900, 500, F("OK"), 5);
-      at.SendATCmdWaitResp(F("AT+HTTPPARA=\"CID\",\"1\""), 900, 500, F("OK"), 5);
-
-      Serial.print(F("AT+HTTPPARA=\"URL\",\""));
-      Serial.print(url);
-      Serial.println(F("\""));
-      at.WaitResp(900, 500, F("OK"));
-
-      // GET or POST (or HEAD)
-      at.SendATCmdWaitResp(op, 1500, 500, F("OK"), 2);
-
-      // Wait for +HTTPACTION:<op>,200,<bytes>
-      if (RX_FINISHED_STR_RECV == at.WaitResp(20000, 500, respcode)) {
-        // +HTTPACTION:0,200,5 --> get, ok, 5 bytes of data
-        char *p_start;
-        char *p_end;
-        int length = 0;
-        // Get bytes to read
-        p_start = strchr((char *)(at.comm_buf), ':');
-        p_start = strchr(p_start, ',');
-        p_start = strchr(p_start, ',');
-        if (p_start != NULL) {
-          length = atoi(p_start+1);
-        }
-
-        // Read response
-        Serial.print(F("AT+HTTPREAD=0,"));
-        Serial.println(length);
-
-        if (RX_FINISHED_STR_RECV == at.WaitResp(1500, 500, F("OK"))) {
-          // <CR><LF>+HTTPREAD:5<CR><LF>DATAHERE<CR><LF>OK
-
-          p_start = strchr((char *)(at.comm_buf), ':');
-          p_start = strchr((char *)(p_start), 0x0d);
-          p_start = p_start + 2;
-          p_end = strchr((char *)(p_start), 0x0d);
-          *p_end = 0;
-          strcpy(result, (char *)(p_start));
-
-          res_code = HTTP_OK;
-        }
-      }
+byte GSM::HttpGet(const char *url, char *result, uint16_t max_len) {
+  return http.Action(HTTP_METHOD_GET, url, result, max_len);
+}
 
-// got OK +HTTPACTION:0,601,0  --> get, network error, no data
-// +HTTPACTION:0,200,5 --> get, ok, 5 bytes of data
-//+HTTPREAD:5
+byte GSM::HttpGet(const char *url, http_sink_t sink, void *context) {
+  return http.Action(HTTP_METHOD_GET, url, sink, context);
+}
 
-      // stop
-      at.SendATCmdWaitResp(F("AT+HTTPTERM"), 900, 500, F("OK"), 5);
-    }
+byte GSM::HttpPost(const char *urlp, char *result) {
+  return http.Action(HTTP_METHOD_POST, urlp, result);
+}
 
-    //at.SendATCmdWaitResp(F("AT+SAPBR=0,1"), 900, 500, F("OK"), 5); // close bearer
-    
-    return res_code;
+byte GSM::HttpPost(const char *url, const __FlashStringHelper *type, const char *body, char *result) {
+  return http.Post(url, type, body, result);
 }
 
 
@@ -2050,151 +2298,297 @@ GPS Section
 TODO Break this file into three parts, (1) Common serial support, (2) GSM/GPRS, and (3) GPS.
 *********************************************************/
 
+/**********************************************************
+Method prepares the AT channel for a GPS command
+- GPS is controlled and read by AT commands of the GSM UART
+  so the serial line is switched only if it is not already
+  on the GSM UART (see ModeGSM())
+
+return: 1 - AT command can be sent
+        0 - NMEA is streamed (see StartNmea())
+**********************************************************/
+byte GSM::GpsAtAccess(void)
+{
+  if (CLS_GPS == at.GetCommLineStatus()) return (0);
+  ModeGSM();
+  return (1);
+}
+
 void GSM::InitGPS(){
+  if (!GpsAtAccess()) return;
   Ready();
-  at.SendATCmdWaitResp(F("AT+CGPSIPR=9600"), 1200, 100, F("OK"), 5); // set the baud rate
-  at.SendATCmdWaitResp(F("AT+CGPSOUT=0"), 1200, 100, F("OK"), 5); // nmea output off
-  at.SendATCmdWaitResp(F("AT+CGPSPWR=1"), 1200, 100, F("OK"), 5); // turn on GPS power supply
-  at.SendATCmdWaitResp(F("AT+CGPSRST=0"), 1200, 100, F("OK"), 5); // cold reset GPS (just do this once)
-  at.SendATCmdWaitResp(F("AT+CGPSPWR=0"), 2000, 100, F("OK"), 5); // turn off GPS power supply
+  at.SendATCmdWaitResp(ATC_CGPSIPR); // set the baud rate
+  at.SendATCmdWaitResp(ATC_CGPSOUT_OFF); // nmea output off
+  at.SendATCmdWaitResp(ATC_CGPSPWR_ON); // turn on GPS power supply
+  at.SendATCmdWaitResp(ATC_CGPSRST_COLD); // cold reset GPS (just do this once)
+  at.SendATCmdWaitResp(ATC_CGPSPWR_OFF); // turn off GPS power supply
+  gps_power = 0;
   Ready();
 }
 
+/**********************************************************
+Method turns the GPS power supply on
+- there is no reset, so the receiver makes the hot start 
+  with the ephemeris and time it kept from the last run
+  (see ResetGPS() to force other start)
+- nothing is sent if the GPS is known to be on, the state
+  is unknown after TurnOn() and InitParam(PARAM_SET_0)
+**********************************************************/
 void GSM::StartGPS(){
-  Ready();
-  at.SendATCmdWaitResp(F("AT+CGPSPWR=1"), 900, 100, F("OK"), 5); // turn on GPS power supply
-  // TODO is the reset required?
-  at.SendATCmdWaitResp(F("AT+CGPSRST=1"), 900, 100, F("OK"), 5); // reset GPS in autonomy mode
+  if (gps_power == 1) return;
+  if (!GpsAtAccess()) return;
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_CGPSPWR_ON)) { // turn on GPS power supply
+    gps_power = 1;
+  }
 }
 
 void GSM::StopGPS(){
-  Ready();
-  at.SendATCmdWaitResp(F("AT+CGPSPWR=0"), 900, 100, F("OK"), 5); // turn off
+  if (gps_power == 0) return;
+  if (!GpsAtAccess()) return;
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_CGPSPWR_OFF)) { // turn off
+    gps_power = 0;
+  }
 }
 
-byte GSM::CheckLocation(position_t& loc) {
-
-  byte retcode = GEN_FAILURE;
-  char latitude[15];
-  char longitude[15];
+/**********************************************************
+Method resets the GPS receiver (AT+CGPSRST)
 
-  if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT+CGPSSTATUS?"), 900, 50, F("OK"), 2)) {
-    if (at.IsStringReceived(F("+CGPSSTATUS: Location 2D Fix")) ||
-        at.IsStringReceived(F("+CGPSSTATUS: Location 3D Fix"))) {
+mode: GPS_RST_COLD - all the kept data are dropped
+      GPS_RST_HOT  - autonomy mode, kept data are used
+      GPS_RST_WARM - kept almanac and time are used
+**********************************************************/
+void GSM::ResetGPS(byte mode){
+  if (!GpsAtAccess()) return;
+  switch (mode) {
+    case GPS_RST_COLD:
+      at.SendATCmdWaitResp(ATC_CGPSRST_COLD);
+      break;
+    case GPS_RST_HOT:
+      at.SendATCmdWaitResp(ATC_CGPSRST_HOT);
+      break;
+    case GPS_RST_WARM:
+      at.SendATCmdWaitResp(ATC_CGPSRST_WARM);
+      break;
+  }
+}
 
-      if (AT_RESP_OK == at.SendATCmdWaitResp(F("AT+CGPSINF=0"), 900, 50, F("OK"), 2)) {
-        // Have location in form: 
-        // <CR><LF>0,17446.647913,-4117.068521,0.082149,20131025231125.000,534,5,0.000000,0.000000<CR><LF>OK
-        // mode, long, lat, alt, utc time, ttff, num, speed, course -- where 'ttff' = time to first fix (seconds)
+byte GSM::CheckLocation(position_t& loc) {
+  position_e6_t loc_e6;
+  byte retcode = CheckLocation(loc_e6);
 
-        strtok((char *)(at.comm_buf), ",");
-        strcpy(longitude,strtok(NULL, ",")); // Gets longitude
-        strcpy(latitude,strtok(NULL, ",")); // Gets latitude
+  if (retcode == GEN_SUCCESS) {
+    loc.lat = GpsMicroToDegrees(loc_e6.lat);
+    loc.lon = GpsMicroToDegrees(loc_e6.lon);
+  }
+  return retcode;
+}
 
-        loc.lat = LocInDegrees(latitude);
-        loc.lon = LocInDegrees(longitude);
+byte GSM::CheckLocation(position_e6_t& loc) {
+  gps_fix_t fix;
+  byte retcode = CheckFix(fix);
 
-        retcode = GEN_SUCCESS;
-      }
-    }
-  }
+  if (retcode == GEN_SUCCESS) loc = fix.pos;
   return retcode;
 }
 
-/**
- * E.g.
- * Lat -4117.015786 --> -41.283596
- * Lng 17446.508384 --> 174.775146
- */
-double GSM::LocInDegrees(char* input) {
-  char *p;
-  float deg;
-  float minutes;
-  boolean neg = false;
+/**********************************************************
+Method reads the complete GPS fix
+- status and record are read by one concatenated command
+  AT+CGPSSTATUS?;+CGPSINF=0, so there is only one round trip
+- if the module rejects the concatenated command both 
+  commands are sent separately, after GPS_QUERY_ERRORS_MAX
+  rejections in a row while the GPS is known to be on (see
+  StartGPS()) from then on (until TurnOn() or
+  InitParam(PARAM_SET_0)) - a single ERROR can be transient,
+  e.g. just after AT+CGPSPWR
+
+fix: fix.fix is always filled by the fix type from the
+     AT+CGPSSTATUS?, other fields only in case of success
+
+return: GEN_SUCCESS - 2D or 3D fix was read
+        GEN_FAILURE - there is no fix or GPS did not answer
+**********************************************************/
+byte GSM::CheckFix(gps_fix_t& fix) {
+
+  byte retcode = GEN_FAILURE;
+  byte split = gps_query_split;
+  const char *p;
+  const char *status;
 
-  char aux[10];
+  fix.fix = GPS_FIX_UNKNOWN;
+  if (!GpsAtAccess()) return retcode;
 
-  p = input;
-  if (input[0] == '-') {
-    neg = true;
-    p = p+1;
+  if (!split) {
+    // <CR><LF>+CGPSSTATUS: Location 3D Fix<CR><LF>
+    // <CR><LF>0,17446.647913,-4117.068521,...<CR><LF>
+    // <CR><LF>OK<CR><LF>
+    if (AT_RESP_OK != at.SendATCmdWaitResp(ATC_CGPS_QUERY)) {
+      if (!at.HasToken(AT_TOK_ERROR)) return retcode;
+      // ERROR of the GPS which is off or not known to be on
+      // (e.g. just powered by AT+CGPSPWR) does not count
+      if (gps_power == 1 && ++gps_query_errors >= GPS_QUERY_ERRORS_MAX) gps_query_split = 1;
+      split = 1;
+    }
+    else gps_query_errors = 0;
+  }
+  if (split
+      && AT_RESP_OK != at.SendATCmdWaitResp(ATC_CGPSSTATUS)) {
+    return retcode;
   }
 
-  deg = atof(strcpy(aux, strtok(p, ".")));
-  minutes = atof(strcpy(aux, strtok(NULL, '\0')));
-  minutes /= 1000000;
+  // +CGPSSTATUS: Location 3D Fix / 2D Fix / Not Fix
+  status = at.FindToken(AT_TOK_CGPSSTATUS);
+  if (status == NULL) return retcode;
+  if (strncmp_P(status + 13, PSTR("Location "), 9) == 0) {
+    switch (status[22]) {
+      case '3': fix.fix = GPS_FIX_3D; break;
+      case '2': fix.fix = GPS_FIX_2D; break;
+      case 'N': fix.fix = GPS_FIX_NONE; break;
+    }
+  }
 
-  if (deg < 100) {
-    minutes += deg;
-    deg = 0;
+  if (fix.fix != GPS_FIX_2D && fix.fix != GPS_FIX_3D) return retcode;
+
+  if (split) {
+    if (AT_RESP_OK != at.SendATCmdWaitResp(ATC_CGPSINF)) return retcode;
+    p = (const char *)(at.comm_buf);
   }
   else {
-    minutes += int(deg) % 100;
-    deg = int(deg) / 100;
+    // record follows the status line
+    p = strchr(status, 0x0a);
+    if (p == NULL) return retcode;
   }
 
-  deg = deg + minutes/60;
+  // Have location in form: 
+  // <CR><LF>0,17446.647913,-4117.068521,0.082149,20131025231125.000,534,5,0.000000,0.000000<CR><LF>OK
+  // mode, long, lat, alt, utc time, ttff, num, speed, course -- where 'ttff' = time to first fix (seconds)
 
-  if (neg == true) {
-    deg *= -1.0;
-  }
+  // parsed in place - the comm buffer is not modified
+  if (GpsParseInf(p, fix)) retcode = GEN_SUCCESS;
+
+  return retcode;
+}
+
+/**********************************************************
+Method sets which NMEA sentences are output by the GPS UART
+(AT+CGPSOUT), the serial line stays on the GSM UART
+
+sentences: mask of NMEA_OUT_xxx, NMEA_OUT_FIX for NmeaParser,
+           0 - NMEA output off
+
+return: GEN_SUCCESS - output was set
+        GEN_FAILURE - line is busy or the module did not answer
+**********************************************************/
+byte GSM::SetNmeaOutput(byte sentences)
+{
+  byte ret_val = GEN_FAILURE;
+
+  if (!GpsAtAccess()) return (ret_val);
+  if (CLS_FREE != at.GetCommLineStatus()) return (ret_val);
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  at.Port().print(F("AT+CGPSOUT="));
+  at.Port().println((int)sentences);
+  if (RX_FINISHED_STR_RECV == at.WaitResp(1200, 100, F("OK"))) ret_val = GEN_SUCCESS;
+
+  at.SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method starts streaming NMEA mode
+- NMEA output of the GPS UART is enabled by AT+CGPSOUT
+- serial line is switched to the GPS UART, so the comm line
+  status is CLS_GPS and no AT command can be sent until
+  StopNmea() is called
+- GPS must be started (see StartGPS())
 
-  neg = false;
+sentences: mask of NMEA_OUT_xxx, NMEA_OUT_FIX for NmeaParser
 
-  if ( deg < 0 ) {
-    neg = true;
-    deg *= -1;
+return: GEN_SUCCESS - NMEA is streamed
+        GEN_FAILURE - line is busy or the module did not answer
+**********************************************************/
+byte GSM::StartNmea(byte sentences)
+{
+  if (GEN_SUCCESS != SetNmeaOutput(sentences)) return (GEN_FAILURE);
+
+  ModeGPS();
+  at.SetCommLineStatus(CLS_GPS);
+  return (GEN_SUCCESS);
+}
+
+/**********************************************************
+Method feeds all the NMEA characters received so far to the
+parser, it does not wait for further characters so it can be
+called from loop() as often as needed
+
+return: NMEA_FIX  - at least one epoch was completed (the 
+                    handler of the parser was called)
+        NMEA_NONE - no complete epoch yet or NMEA not started
+**********************************************************/
+byte GSM::ReadNmea(NmeaParser &nmea)
+{
+  byte ret_val = NMEA_NONE;
+
+  if (CLS_GPS != at.GetCommLineStatus()) return (ret_val);
+
+  while (at.Port().available()) {
+    if (NMEA_FIX == nmea.Feed(at.Port().read())) ret_val = NMEA_FIX;
   }
+  return (ret_val);
+}
+
+/**********************************************************
+Method reads NMEA in one window without streaming mode
+- serial line is switched to the GPS UART, NMEA is read 
+  until the required num. of epochs is complete or the 
+  window times out and the line is switched back - so there
+  is only one switch pair for the whole batch of fixes
+- NMEA output must be enabled by SetNmeaOutput()
+- URCs of the GSM UART are lost during the window
+
+epochs:  num. of epochs to read (1 - next fix)
+tmout:   max. length of the window in msec.
+
+return: num. of epochs read
+**********************************************************/
+byte GSM::ReadNmeaWindow(NmeaParser &nmea, byte epochs, uint16_t tmout)
+{
+  byte count = 0;
+  unsigned long start;
 
-  int int_part[10];
-  int f;
-  long num_part = (long)deg;
-  float decimal_part = (deg - (int)deg);
-  int size = 0;
+  if (CLS_FREE != at.GetCommLineStatus()) return (count);
+  at.SetCommLineStatus(CLS_GPS);
+  ModeGPS();
 
-  while (1) {
-    size = size + 1;
-    f = num_part % 10;
-    num_part = num_part / 10;
-    int_part[size-1] = f;
-    if (num_part == 0) {
-      break;
+  start = millis();
+  while (count < epochs && (unsigned long)(millis() - start) < tmout) {
+    while (at.Port().available() && count < epochs) {
+      if (NMEA_FIX == nmea.Feed(at.Port().read())) count++;
     }
   }
 
-  int index=0;
-  if (neg) {
-    index++;
-    input[0] = '-';
-  }
-  for (int i = size-1; i >= 0; i--) {
-    input[index] = int_part[i] + '0'; 
-    index++;
-  }
+  ModeGSM();
+  at.SetCommLineStatus(CLS_FREE);
+  return (count);
+}
 
-  input[index]='.';
-  index++;
+/**********************************************************
+Method stops streaming NMEA mode, switches the serial line 
+back to the GSM UART and turns the NMEA output off
+**********************************************************/
+void GSM::StopNmea(void)
+{
+  if (CLS_GPS != at.GetCommLineStatus()) return;
 
-  for (int i = 1; i <= 6 ; i++) {
-    decimal_part = decimal_part * 10;
-    f = (long)decimal_part;
-    decimal_part = decimal_part - f;
-    input[index] = char(f) + 48;
-    index++;
-  }
-  input[index] = '\0';
-  return atof(input);
+  ModeGSM();
+  at.SetCommLineStatus(CLS_FREE);
+  SetNmeaOutput(0);
 }
 
-/**
- * http://en.wikipedia.org/wiki/Law_of_haversines
- */
+// see GeoRadiansBetween(), for many points see GeoDistances()
 double GSM::EarthRadiansBetween(const position_t& from, const position_t& to) {
-  double lat_radians = (from.lat - to.lat) * DEG_TO_RAD;
-  double lon_radians = (from.lon - to.lon) * DEG_TO_RAD;
-  double lat_haversine = pow(sin(lat_radians * 0.5), 2);
-  double lon_haversine = pow(sin(lon_radians * 0.5), 2);
-  return 2.0 * asin(sqrt(lat_haversine + (cos(from.lat * DEG_TO_RAD) * cos(to.lat * DEG_TO_RAD) * lon_haversine)));
+  return GeoRadiansBetween(from, to);
 }
 
 double GSM::DistanceBetween(const position_t& from, const position_t& to) {
@@ -10,6 +10,10 @@ This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt fi
 #include "Arduino.h"
 #include <avr/pgmspace.h>
 #include "sqrl_at.h"
+#include "sqrl_http.h"
+#include "sqrl_gps.h"
+#include "sqrl_nmea.h"
+#include "sqrl_geo.h"
 
 // if defined - SMSs are not send(are finished by the character 0x1b
 // which causes that SMS are not send)
@@ -34,14 +38,36 @@ This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt fi
 //#define DTMF_NOT_VALID      0x10
 
 
+// serial line selection - see ModeGSM(), ModeGPS()
+#define UART_UNKNOWN  0
+#define UART_GSM      1
+#define UART_GPS      2
+
+// GPS power state is not known yet - see StartGPS()
+#define GPS_POWER_UNKNOWN  0xff
+
+// num. of ERRORs in a row to AT+CGPSSTATUS?;+CGPSINF=0 before
+// the commands are sent separately - see CheckFix()
+#define GPS_QUERY_ERRORS_MAX  3
+
 // status bits definition
 #define STATUS_NONE                 0
 #define STATUS_INITIALIZED          1
 #define STATUS_REGISTERED           2
 #define STATUS_USER_BUTTON_ENABLE   4
+#define STATUS_INIT_PENDING         8
+
+// network info sampling - see SetNetSampling()
+#define NET_SAMPLE_INTERVAL   30000 // default interval between +CSQ samples in msec.
+#define NET_OPER_EVERY        10    // +COPS? is sampled with every N-th +CSQ sample
+#define NET_RSSI_UNKNOWN      99
+#define NET_OPER_LEN          16
 
-#define DEG_TO_RAD 0.017453292519943295769236907684886 // or, pi div 180
-#define EARTH_MEAN_RADIUS 6372797.560856 // metres
+// lengths of the strings returned to the caller, the caller's
+// buffers must have one more character for the 0x00 termination
+#define GSM_PHONE_NUM_LEN     19    // GetPhoneNumber(), GetSMS(), CallStatusWithAuth()
+#define GSM_ICCID_LEN         20    // GetICCID()
+#define GSM_DATE_TIME_LEN     20    // GetDateTime() - "yy/MM/dd,hh:mm:ss+zz"
 
 // return codes
 #define GEN_FAILURE 0
@@ -56,14 +82,6 @@ enum sms_type_enum
   SMS_ALL
 };
 
-enum comm_line_status_enum 
-{
-  // CLS like CommunicationLineStatus
-  CLS_FREE,   // line is free - not used by the communication and can be used
-  CLS_ATCMD,  // line is used by AT commands, includes also time for response
-  CLS_DATA   // for the future - line is used in the CSD or GPRS communication  
-};
-
 enum ready_enum {
   READY_NO = 0,
   READY_YES
@@ -105,20 +123,22 @@ enum getsms_ret_val_enum
   GETSMS_AUTH_SMS
 };
 
-enum httpget_ret_val_enum {
-  HTTP_OK = 0,
-  HTTP_FAIL
-};
-
-struct position_t {
-  double lat;
-  double lon;
+// network info snapshot updated by the Poll() method
+struct net_info_t {
+  byte rssi;                  // last +CSQ rssi <0..31>, NET_RSSI_UNKNOWN - not known
+  byte ber;                   // last +CSQ bit error rate <0..7>, 99 - not known
+  uint16_t rssi_avg8;         // rolling average of rssi multiplied by 8
+  char oper[NET_OPER_LEN+1];  // operator name from +COPS?
+  uint16_t lac;               // location area code
+  uint16_t cell_id;           // cell ID
+  unsigned long sampled_at;   // millis() of the last +CSQ sample, 0 - no sample yet
 };
 
 class GSM
 {
   public:
     GSM(void);
+    GSM(AtComms &comms);
     void InitSerLine();
 
     void ModeInit(void);
@@ -131,9 +151,18 @@ class GSM
     //byte GetDTMFSignal(void);
     byte GetICCID(char *id_string);
     void SetSpeaker(byte off_on);
-    byte CheckRegistration(void); // must be called regularly
+    byte CheckRegistration(void);
     byte IsRegistered(void);
     byte IsInitialized(void);
+    inline uint16_t GetLAC(void) {return reg_lac;};
+    inline uint16_t GetCellID(void) {return reg_cell_id;};
+    void Poll(void); // must be called regularly
+
+    // network info
+    inline void SetNetSampling(unsigned long interval) {net_sample_interval = interval;};
+    inline const net_info_t& GetNetInfo(void) {return net_info;};
+    byte GetSignalAvg(void);
+    int GetSignalDbm(void);
     byte CallStatus(void);
     byte CallStatusWithAuth(char *phone_number, byte &fav,
                             byte first_authorized_pos, byte last_authorized_pos);
@@ -179,13 +208,27 @@ class GSM
     // data
     void SetupGPRS(void);
     byte HttpGet(const char *url, char *result);
+    byte HttpGet(const char *url, char *result, uint16_t max_len);
+    byte HttpGet(const char *url, http_sink_t sink, void *context);
     byte HttpPost(const char *urlp, char *result);
+    byte HttpPost(const char *url, const __FlashStringHelper *type, const char *body, char *result);
+    inline HttpSession& Http(void) {return http;};
+    inline AtComms& Comms(void) {return at;};
 
     // gps
     void InitGPS(void);
     void StartGPS(void);
     void StopGPS(void);
+    void ResetGPS(byte mode);
+    inline byte IsGPSOn(void) {return (gps_power == 1);};
     byte CheckLocation(position_t& loc);
+    byte CheckLocation(position_e6_t& loc);
+    byte CheckFix(gps_fix_t& fix);
+    byte SetNmeaOutput(byte sentences);
+    byte StartNmea(byte sentences);
+    byte ReadNmea(NmeaParser &nmea);
+    byte ReadNmeaWindow(NmeaParser &nmea, byte epochs, uint16_t tmout);
+    void StopNmea(void);
     double EarthRadiansBetween(const position_t& from, const position_t& to);
     double DistanceBetween(const position_t& from, const position_t& to);
 
@@ -195,15 +238,57 @@ class GSM
 #endif
 
   private:
-    AtComms at;
+    AtComms &at;
+    HttpSession http;
     byte module_status; // global status - bit mask
     byte last_speaker_volume; // last value of speaker volume
-
+    uint16_t reg_lac;         // location area code from the last +CREG
+    uint16_t reg_cell_id;     // cell ID from the last +CREG
+    net_info_t net_info;
+    unsigned long net_sample_interval;
+    unsigned long net_polled_at;  // millis() of the last SampleNetInfo(), 0 - never
+    byte net_sample_count;
+    byte gps_query_split;     // module does not accept AT+CGPSSTATUS?;+CGPSINF=0
+    byte gps_query_errors;    // ERRORs in a row to the concatenated command
+    byte uart_mode;           // UART_xxx selected by the pins 3/4
+    byte echo_off;            // ATE0 was sent to the GSM UART
+    byte gps_power;           // 0 - off, 1 - on, GPS_POWER_UNKNOWN
+
+    void Init(void);
     char InitSMSMemory(void);
 
-    byte HttpOperation(const __FlashStringHelper *op, const __FlashStringHelper *respcode, const char *url, char *result);
+    static byte UrcHandler(void *context, byte token, const char *line, byte len);
+    byte HandleUrc(byte token, const char *line, byte len);
+    void ParseRegistration(const char *p, byte len);
+    void RunPendingInit(void);
+    void ParseSignalQuality(const char *p, byte len);
+    void ParseOperator(const char *p, byte len);
+    void SampleNetInfo(void);
+    byte GpsAtAccess(void);
+
+};
+
+// holds the comm buffer of SizedGSM, it is a base class so the
+// buffer is constructed before GSM
+template <unsigned int N>
+struct SizedGSMBuffer {
+  AtCommsBuffer<N> sized_comms;
+};
+
+/**********************************************************
+  GSM with the comm buffer of N characters instead of the
+  default COMM_BUF_LEN, the length is checked at compile time
 
-    double LocInDegrees(char* input);
+  e.g. SizedGSM<128> gsm; saves 72 bytes of RAM
 
+  Every SizedGSM has its own buffer, so more modems are
+  driven by more SizedGSM objects (not by more GSM(void)).
+**********************************************************/
+template <unsigned int N>
+class SizedGSM : private SizedGSMBuffer<N>, public GSM {
+  public:
+    SizedGSM(void) : GSM(SizedGSMBuffer<N>::sized_comms) {
+      SQRL_REPORT_RAM_USE(sizeof(SizedGSM<N>));
+    };
 };
 #endif
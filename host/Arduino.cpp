@@ -0,0 +1,107 @@
+/*
+Arduino.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "Arduino.h"
+#include <stdio.h>
+#include <time.h>
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+static unsigned long long MonotonicUsec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+unsigned long millis(void)
+{
+  return ((unsigned long)(MonotonicUsec() / 1000));
+}
+
+unsigned long micros(void)
+{
+  return ((unsigned long)MonotonicUsec());
+}
+
+void delay(unsigned long ms)
+{
+  struct timespec ts;
+
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000L;
+  while (nanosleep(&ts, &ts) != 0) ;
+}
+
+long random(long max_val)
+{
+  if (max_val <= 0) return (0);
+  return (::random() % max_val);
+}
+
+long random(long min_val, long max_val)
+{
+  if (min_val >= max_val) return (min_val);
+  return (min_val + random(max_val - min_val));
+}
+
+size_t Print::write(const uint8_t *buf, size_t size)
+{
+  size_t n = 0;
+
+  while (size--) n += write(*buf++);
+  return (n);
+}
+
+size_t Print::PrintNumber(unsigned long n, byte base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+
+  if (base < 2) base = 10;
+  *p = 0x00;
+  do {
+    byte digit = n % base;
+    *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    n /= base;
+  } while (n);
+  return (write(p));
+}
+
+size_t Print::print(const __FlashStringHelper *str) {return write((const char *)str);}
+size_t Print::print(const char *str) {return write(str);}
+size_t Print::print(char c) {return write((uint8_t)c);}
+size_t Print::print(unsigned char n, int base) {return PrintNumber(n, base);}
+size_t Print::print(int n, int base) {return print((long)n, base);}
+size_t Print::print(unsigned int n, int base) {return PrintNumber(n, base);}
+size_t Print::print(unsigned long n, int base) {return PrintNumber(n, base);}
+
+size_t Print::print(long n, int base)
+{
+  if (n < 0 && base == DEC) return (write((uint8_t)'-') + PrintNumber(-n, base));
+  return (PrintNumber(n, base));
+}
+
+size_t Print::print(double n, int digits)
+{
+  char buf[32];
+
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return (write(buf));
+}
+
+size_t Print::println(void) {return write("\r\n");}
+size_t Print::println(const __FlashStringHelper *str) {return print(str) + println();}
+size_t Print::println(const char *str) {return print(str) + println();}
+size_t Print::println(char c) {return print(c) + println();}
+size_t Print::println(unsigned char n, int base) {return print(n, base) + println();}
+size_t Print::println(int n, int base) {return print(n, base) + println();}
+size_t Print::println(unsigned int n, int base) {return print(n, base) + println();}
+size_t Print::println(long n, int base) {return print(n, base) + println();}
+size_t Print::println(unsigned long n, int base) {return print(n, base) + println();}
+size_t Print::println(double n, int digits) {return print(n, digits) + println();}
@@ -0,0 +1,102 @@
+/*
+Arduino.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_HOST_ARDUINO_H
+#define __SQRL_HOST_ARDUINO_H
+
+/**********************************************************
+  Arduino shim for the Linux host (see sqrl_gateway.h)
+
+  Just the part of the Arduino core used by the library:
+  types, F(), millis() from CLOCK_MONOTONIC, Print and Stream.
+  Pins are ignored and Serial is not connected, the modems
+  are reached by TermiosStream set by AtComms::SetPort().
+**********************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stddef.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+#define DEC     10
+#define HEX     16
+
+// strings stay in RAM on the host
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+inline void pinMode(uint8_t pin, uint8_t mode) {};
+inline void digitalWrite(uint8_t pin, uint8_t val) {};
+inline int digitalRead(uint8_t pin) {return LOW;};
+long random(long max_val);
+long random(long min_val, long max_val);
+
+class Print {
+  private:
+    size_t PrintNumber(unsigned long n, byte base);
+
+  public:
+    virtual ~Print() {};
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size);
+    size_t write(const char *str) {return write((const uint8_t *)str, strlen(str));};
+    virtual void flush(void) {};
+
+    size_t print(const __FlashStringHelper *str);
+    size_t print(const char *str);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(const __FlashStringHelper *str);
+    size_t println(const char *str);
+    size_t println(char c);
+    size_t println(unsigned char n, int base = DEC);
+    size_t println(int n, int base = DEC);
+    size_t println(unsigned int n, int base = DEC);
+    size_t println(long n, int base = DEC);
+    size_t println(unsigned long n, int base = DEC);
+    size_t println(double n, int digits = 2);
+    size_t println(void);
+};
+
+class Stream : public Print {
+  public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+};
+
+// UART of a board, not connected on the host
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) {};
+    int available(void) {return 0;};
+    int read(void) {return -1;};
+    int peek(void) {return -1;};
+    size_t write(uint8_t c) {return 1;};
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
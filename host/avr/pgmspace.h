@@ -0,0 +1,33 @@
+/*
+pgmspace.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_HOST_PGMSPACE_H
+#define __SQRL_HOST_PGMSPACE_H
+
+// program memory shim for the Linux host - one address space
+
+#include <stdint.h>
+#include <string.h>
+
+typedef char prog_char;
+
+#define PROGMEM
+#define PGM_P                   const char *
+#define PSTR(s)                 (s)
+
+#define pgm_read_byte(p)        (*(const unsigned char *)(p))
+#define pgm_read_word(p)        (*(const unsigned short *)(p))
+#define pgm_read_dword(p)       (*(const uint32_t *)(p))
+#define pgm_read_ptr(p)         (*(void * const *)(p))
+
+#define memcpy_P                memcpy
+#define strcpy_P                strcpy
+#define strcmp_P                strcmp
+#define strncmp_P               strncmp
+#define strlen_P                strlen
+#define strstr_P                strstr
+
+#endif
@@ -0,0 +1,104 @@
+/*
+gateway.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+/**********************************************************
+  Modem bank gateway
+
+  Configures every modem and samples the signal and the
+  operator of all of them every GW_SAMPLE_INTERVAL.
+
+  usage: gateway <baud> <tty> [<tty> ...]
+
+  built from the library directory together with the library
+  sources and the host shim, e.g.
+    g++ -O2 -Ihost -I. host/Arduino.cpp host/sqrl_termios.cpp \
+        host/sqrl_gateway.cpp host/gateway.cpp *.cpp -o gateway
+**********************************************************/
+
+#include "sqrl_gateway.h"
+#include <signal.h>
+#include <stdio.h>
+
+#ifndef GW_SAMPLE_INTERVAL
+#define GW_SAMPLE_INTERVAL  30000   // msec.
+#endif
+
+static volatile sig_atomic_t running = 1;
+
+static void Stop(int sig)
+{
+  running = 0;
+}
+
+static void Done(void *context, byte modem, byte cmd, byte result)
+{
+  ModemGateway *gw = (ModemGateway *)context;
+  GSM &gsm = gw->Modem(modem).gsm;
+  const net_info_t &info = gsm.GetNetInfo();
+
+  if (result != RESP_OK) {
+    printf("%u: %s failed\n", modem, (const char *)AtComms::CmdString(cmd));
+    return;
+  }
+  // the info is parsed by the GSM from the responses and +CREG URCs
+  if (cmd == ATC_COPS) {
+    printf("%u: rssi %u ber %u oper \"%s\" lac %04x cell %04x\n", modem,
+           info.rssi, info.ber, info.oper, gsm.GetLAC(), gsm.GetCellID());
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  ModemGateway gw;
+  unsigned long baud;
+  unsigned long next_sample;
+  long wait;
+  byte i;
+
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <baud> <tty> [<tty> ...]\n", argv[0]);
+    return (2);
+  }
+  baud = strtoul(argv[1], NULL, 10);
+
+  if (gw.Begin() != 0) {
+    perror("epoll");
+    return (1);
+  }
+  for (i = 2; i < argc && i - 2 < GW_MODEMS_MAX; i++) {
+    if (gw.AddModem(argv[i], baud) < 0) fprintf(stderr, "%s: not opened\n", argv[i]);
+  }
+  if (gw.ModemCount() == 0) return (1);
+
+  signal(SIGINT, Stop);
+  signal(SIGTERM, Stop);
+  gw.OnDone(Done, &gw);
+
+  for (i = 0; i < gw.ModemCount(); i++) {
+    gw.Submit(i, ATC_AT);
+    gw.Submit(i, ATC_ECHO_OFF);
+    gw.Submit(i, ATC_CREG_LOC);
+  }
+
+  next_sample = millis();
+  while (running) {
+    wait = (long)(next_sample - millis());
+    if (wait <= 0) {
+      for (i = 0; i < gw.ModemCount(); i++) {
+        if (!gw.IsUp(i)) continue;
+        gw.Submit(i, ATC_CSQ);
+        gw.Submit(i, ATC_COPS);
+      }
+      next_sample += GW_SAMPLE_INTERVAL;
+      continue;
+    }
+    if (gw.Run(wait) < 0) {
+      perror("epoll_wait");
+      return (1);
+    }
+  }
+  return (0);
+}
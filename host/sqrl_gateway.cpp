@@ -0,0 +1,266 @@
+/*
+sqrl_gateway.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_gateway.h"
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// epoll data: index of the modem << 1 | GW_EV_TIMER
+#define GW_EV_TIMER     1
+
+GatewayModem::GatewayModem(void) : gsm(comms) {
+  state = GW_DOWN;
+  cmd = 0;
+  queue_head = queue_tail = 0;
+  timer_fd = -1;
+  events = 0;
+  comms.SetPort(&port);
+}
+
+ModemGateway::ModemGateway(void) {
+  epoll_fd = -1;
+  modem_count = 0;
+  done = NULL;
+  done_context = NULL;
+}
+
+ModemGateway::~ModemGateway(void) {
+  byte i;
+
+  for (i = 0; i < modem_count; i++) {
+    if (modems[i]->timer_fd >= 0) close(modems[i]->timer_fd);
+    delete modems[i];
+  }
+  if (epoll_fd >= 0) close(epoll_fd);
+}
+
+/**********************************************************
+Method creates the epoll instance
+
+return: 0 - ok, -1 - error (see errno)
+**********************************************************/
+int ModemGateway::Begin(void)
+{
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  return (epoll_fd < 0 ? -1 : 0);
+}
+
+/**********************************************************
+Method opens the port of a modem and adds it to the loop
+
+return: index of the modem, -1 - not added
+**********************************************************/
+int ModemGateway::AddModem(const char *path, unsigned long baud)
+{
+  GatewayModem *m;
+  struct epoll_event ev;
+  byte i = modem_count;
+
+  if (epoll_fd < 0 || modem_count >= GW_MODEMS_MAX) return (-1);
+  m = new GatewayModem();
+  m->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (m->timer_fd < 0 || m->port.Open(path, baud) < 0) {
+    if (m->timer_fd >= 0) close(m->timer_fd);
+    delete m;
+    return (-1);
+  }
+
+  ev.events = EPOLLIN;
+  ev.data.u64 = ((uint64_t)i << 1) | GW_EV_TIMER;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, m->timer_fd, &ev) != 0) {
+    close(m->timer_fd);
+    delete m;
+    return (-1);
+  }
+  ev.data.u64 = (uint64_t)i << 1;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, m->port.Fd(), &ev) != 0) {
+    close(m->timer_fd);
+    delete m;
+    return (-1);
+  }
+  m->events = EPOLLIN;
+  m->state = GW_IDLE;
+  modems[modem_count++] = m;
+  return (i);
+}
+
+/**********************************************************
+Method queues the command from the table
+
+return: 0 - modem is down or its queue is full
+        1 - command is queued
+**********************************************************/
+byte ModemGateway::Submit(byte i, byte cmd)
+{
+  GatewayModem *m;
+  byte next;
+
+  if (i >= modem_count) return (0);
+  m = modems[i];
+  next = (m->queue_head + 1) & (GW_QUEUE_LEN - 1);
+  if (m->state == GW_DOWN || next == m->queue_tail) return (0);
+  m->queue[m->queue_head] = cmd;
+  m->queue_head = next;
+  if (m->state == GW_IDLE) Service(i);
+  return (1);
+}
+
+/**********************************************************
+Method waits for the events and services the modems
+
+max_wait: max. time to wait in msec., -1 - until an event
+
+return: num. of events, -1 - error of epoll_wait()
+**********************************************************/
+int ModemGateway::Run(int max_wait)
+{
+  struct epoll_event ev[GW_EVENTS_MAX];
+  uint64_t expirations;
+  GatewayModem *m;
+  int n, k;
+  byte i;
+
+  n = epoll_wait(epoll_fd, ev, GW_EVENTS_MAX, max_wait);
+  if (n < 0) return (errno == EINTR ? 0 : -1);
+
+  for (k = 0; k < n; k++) {
+    i = ev[k].data.u64 >> 1;
+    m = modems[i];
+    if (m->state == GW_DOWN) continue;
+
+    if (ev[k].data.u64 & GW_EV_TIMER) {
+      if (::read(m->timer_fd, &expirations, sizeof(expirations)) < 0) {}
+    }
+    else {
+      if ((ev[k].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && m->port.Fill() < 0) {
+        Down(i);
+        continue;
+      }
+      if ((ev[k].events & EPOLLOUT) && m->port.Drain() < 0) {
+        Down(i);
+        continue;
+      }
+    }
+    Service(i);
+  }
+  return (n);
+}
+
+/**********************************************************
+Method moves the modem as far as it can go without waiting
+**********************************************************/
+void ModemGateway::Service(byte i)
+{
+  GatewayModem *m = modems[i];
+  eResp resp;
+  byte rx;
+
+  for (;;) {
+    if (m->state == GW_IDLE) {
+      if (m->queue_tail != m->queue_head) {
+        m->cmd = m->queue[m->queue_tail];
+        m->queue_tail = (m->queue_tail + 1) & (GW_QUEUE_LEN - 1);
+        m->comms.SetCommLineStatus(CLS_ATCMD);
+        m->comms.SendCmd(m->cmd);
+        m->state = GW_CMD;
+      }
+      else if (m->port.available()) {
+        m->comms.SetCommLineStatus(CLS_ATCMD);
+        m->comms.StartRx(GW_URC_START_TMOUT, GW_URC_INTERCHAR_TMOUT);
+        m->state = GW_URC;
+      }
+      else break;
+    }
+
+    if (m->state == GW_CMD) {
+      resp = m->comms.CheckResp();
+      if (resp == RESP_WAIT) break;
+      Finish(i, resp);
+    }
+    else if (m->state == GW_URC) {
+      rx = m->comms.IsRxFinished();
+      if (rx == RX_NOT_FINISHED) break;
+      if (rx == RX_FINISHED) m->comms.DispatchUrcs();
+      m->comms.SetCommLineStatus(CLS_FREE);
+      m->state = GW_IDLE;
+    }
+  }
+
+  Arm(i);
+  Watch(i);
+}
+
+void ModemGateway::Finish(byte i, byte result)
+{
+  GatewayModem *m = modems[i];
+
+  m->comms.SetCommLineStatus(CLS_FREE);
+  m->state = GW_IDLE;
+  if (done != NULL) done(done_context, i, m->cmd, result);
+}
+
+/**********************************************************
+Method arms the timer to the deadline of the reception,
+the timer of an idle modem is disarmed
+**********************************************************/
+void ModemGateway::Arm(byte i)
+{
+  GatewayModem *m = modems[i];
+  struct itimerspec its;
+  long wait;
+
+  memset(&its, 0, sizeof(its));
+  if (m->state == GW_CMD || m->state == GW_URC) {
+    wait = (long)(m->comms.RxDeadline() - millis());
+    if (wait < 0) wait = 0;
+    // +1: millis() is truncated, the timeout must be over when it fires
+    wait++;
+    its.it_value.tv_sec = wait / 1000;
+    its.it_value.tv_nsec = (wait % 1000) * 1000000L;
+  }
+  timerfd_settime(m->timer_fd, 0, &its, NULL);
+}
+
+/**********************************************************
+Method watches the port for writing only while some bytes
+are queued
+**********************************************************/
+void ModemGateway::Watch(byte i)
+{
+  GatewayModem *m = modems[i];
+  struct epoll_event ev;
+  uint32_t events = EPOLLIN;
+
+  if (m->state == GW_DOWN) return;
+  if (m->port.TxPending()) events |= EPOLLOUT;
+  if (events == m->events) return;
+
+  ev.events = events;
+  ev.data.u64 = (uint64_t)i << 1;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, m->port.Fd(), &ev);
+  m->events = events;
+}
+
+/**********************************************************
+Method closes the port of a failed modem, the running
+command finishes with RESP_FAIL, queued ones are dropped
+**********************************************************/
+void ModemGateway::Down(byte i)
+{
+  GatewayModem *m = modems[i];
+  byte running = (m->state == GW_CMD);
+  struct itimerspec its;
+
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, m->port.Fd(), NULL);
+  m->port.Close();
+  memset(&its, 0, sizeof(its));
+  timerfd_settime(m->timer_fd, 0, &its, NULL);
+  m->queue_head = m->queue_tail = 0;
+  m->state = GW_DOWN;
+  if (running && done != NULL) done(done_context, i, m->cmd, RESP_FAIL);
+}
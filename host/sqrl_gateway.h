@@ -0,0 +1,116 @@
+/*
+sqrl_gateway.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_GATEWAY_H
+#define __SQRL_GATEWAY_H
+
+#include "Arduino.h"
+#include "GSM_Shield.h"
+#include "sqrl_termios.h"
+
+/**********************************************************
+  Gateway of a modem bank on a Linux host
+
+  One thread services all the modems from one epoll loop.
+  Every modem has its TermiosStream, AtComms and GSM (the GSM
+  parses the URCs and responses, e.g. GetNetInfo()), its
+  serial fd and a timerfd. Commands from the table (ATC_xxx)
+  are queued per modem and run by the async AtComms API:
+  - the fd readable    - bytes are moved into the stream,
+                         the modem is serviced
+  - the fd writable    - queued bytes are written (only
+                         watched while some are queued)
+  - the timerfd        - armed to AtComms::RxDeadline() while
+                         a reception runs, so the timeouts
+                         need no polling
+  An idle modem has no timer armed, an idle bank sleeps in
+  epoll_wait().
+
+  Bytes received by an idle modem are read as URCs.
+
+  The blocking GSM methods (they wait in WaitResp()) must not
+  be called from the loop - they would stop all the modems.
+
+    ModemGateway gw;
+    gw.Begin();
+    gw.AddModem("/dev/ttyUSB0", 9600);
+    gw.OnDone(Done, NULL);
+    gw.Submit(0, ATC_CSQ);
+    for (;;) gw.Run(-1);
+**********************************************************/
+
+#define GW_MODEMS_MAX           64
+#define GW_QUEUE_LEN            8       // commands queued per modem, power of 2
+#define GW_EVENTS_MAX           32      // events by one epoll_wait()
+#define GW_URC_START_TMOUT      10      // reception of URCs (msec.)
+#define GW_URC_INTERCHAR_TMOUT  50
+
+enum gw_state_enum
+{
+  GW_DOWN,      // port is closed
+  GW_IDLE,      // nothing to do, waiting for commands or URCs
+  GW_CMD,       // command is running
+  GW_URC        // URCs are received
+};
+
+/**********************************************************
+  Handler of finished commands
+
+  context - pointer registered by OnDone()
+  modem   - index returned by AddModem()
+  cmd     - ATC_xxx
+  result  - RESP_OK, RESP_FAIL
+**********************************************************/
+typedef void (*gw_done_t)(void *context, byte modem, byte cmd, byte result);
+
+class GatewayModem {
+  friend class ModemGateway;
+
+  private:
+    byte state;
+    byte cmd;                       // running command
+    byte queue[GW_QUEUE_LEN];
+    byte queue_head, queue_tail;
+    int timer_fd;
+    uint32_t events;                // epoll events watched on the port
+
+  public:
+    GatewayModem(void);
+
+    TermiosStream port;
+    AtCommsBuffer<COMM_BUF_LEN> comms;
+    GSM gsm;
+};
+
+class ModemGateway {
+  private:
+    int epoll_fd;
+    GatewayModem *modems[GW_MODEMS_MAX];
+    byte modem_count;
+    gw_done_t done;
+    void *done_context;
+
+    void Service(byte i);
+    void Finish(byte i, byte result);
+    void Arm(byte i);
+    void Watch(byte i);
+    void Down(byte i);
+
+  public:
+    ModemGateway(void);
+    ~ModemGateway(void);
+
+    int Begin(void);
+    int AddModem(const char *path, unsigned long baud);
+    inline byte ModemCount(void) {return modem_count;};
+    inline GatewayModem &Modem(byte i) {return *modems[i];};
+    inline byte IsUp(byte i) {return modems[i]->state != GW_DOWN;};
+    inline void OnDone(gw_done_t handler, void *context) {done = handler; done_context = context;};
+    byte Submit(byte i, byte cmd);
+    int Run(int max_wait);
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+sqrl_termios.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_termios.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define TERMIOS_RX_MASK     (TERMIOS_RX_LEN - 1)
+#define TERMIOS_TX_MASK     (TERMIOS_TX_LEN - 1)
+
+static speed_t TermiosSpeed(unsigned long baud)
+{
+  switch (baud) {
+    case 4800:   return (B4800);
+    case 9600:   return (B9600);
+    case 19200:  return (B19200);
+    case 38400:  return (B38400);
+    case 57600:  return (B57600);
+    case 115200: return (B115200);
+  }
+  return (B0);
+}
+
+TermiosStream::TermiosStream(void) {
+  fd = -1;
+  rx_head = rx_tail = 0;
+  tx_head = tx_tail = 0;
+  rx_dropped = 0;
+}
+
+TermiosStream::~TermiosStream(void) {
+  Close();
+}
+
+/**********************************************************
+Method opens the serial port
+
+path: e.g. "/dev/ttyUSB0"
+baud: 4800 .. 115200
+
+return: fd of the port, -1 - port was not opened
+**********************************************************/
+int TermiosStream::Open(const char *path, unsigned long baud)
+{
+  struct termios tio;
+  speed_t speed = TermiosSpeed(baud);
+
+  if (speed == B0) return (-1);
+  Close();
+  fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) return (-1);
+
+  if (tcgetattr(fd, &tio) != 0) {
+    Close();
+    return (-1);
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~CRTSCTS;
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+    Close();
+    return (-1);
+  }
+  tcflush(fd, TCIOFLUSH);
+
+  rx_head = rx_tail = 0;
+  tx_head = tx_tail = 0;
+  return (fd);
+}
+
+void TermiosStream::Close(void)
+{
+  if (fd >= 0) close(fd);
+  fd = -1;
+}
+
+/**********************************************************
+Method reads the received bytes into the RX ring, bytes
+which do not fit are dropped and counted
+
+return: num. of bytes read
+        -1 - the port was closed (e.g. USB adapter unplugged)
+**********************************************************/
+int TermiosStream::Fill(void)
+{
+  byte buf[256];
+  int total = 0;
+  int n, i;
+
+  if (fd < 0) return (-1);
+  for (;;) {
+    n = ::read(fd, buf, sizeof(buf));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      return (-1);
+    }
+    if (n == 0) return (total ? total : -1);
+
+    for (i = 0; i < n; i++) {
+      if (((rx_head + 1) & TERMIOS_RX_MASK) == rx_tail) {
+        if (rx_dropped < 0xffff) rx_dropped++;
+        continue;
+      }
+      rx[rx_head] = buf[i];
+      rx_head = (rx_head + 1) & TERMIOS_RX_MASK;
+    }
+    total += n;
+  }
+  return (total);
+}
+
+/**********************************************************
+Method writes the queued bytes the port takes now
+
+return: num. of bytes still queued, -1 - write error
+**********************************************************/
+int TermiosStream::Drain(void)
+{
+  int len;
+  int n;
+
+  if (fd < 0) return (-1);
+  while (tx_tail != tx_head) {
+    // contiguous part of the ring
+    len = (tx_head > tx_tail ? tx_head : TERMIOS_TX_LEN) - tx_tail;
+    n = ::write(fd, &tx[tx_tail], len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      return (-1);
+    }
+    tx_tail = (tx_tail + n) & TERMIOS_TX_MASK;
+  }
+  return (TxPending());
+}
+
+int TermiosStream::available(void)
+{
+  return ((rx_head - rx_tail) & TERMIOS_RX_MASK);
+}
+
+int TermiosStream::read(void)
+{
+  byte c;
+
+  if (rx_head == rx_tail) return (-1);
+  c = rx[rx_tail];
+  rx_tail = (rx_tail + 1) & TERMIOS_RX_MASK;
+  return (c);
+}
+
+int TermiosStream::peek(void)
+{
+  if (rx_head == rx_tail) return (-1);
+  return (rx[rx_tail]);
+}
+
+size_t TermiosStream::write(uint8_t c)
+{
+  return (write(&c, 1));
+}
+
+/**********************************************************
+Method queues the bytes and writes what the port takes
+
+return: num. of bytes queued, less than size if the TX
+        ring is full
+**********************************************************/
+size_t TermiosStream::write(const uint8_t *buf, size_t size)
+{
+  size_t n = 0;
+
+  while (n < size && ((tx_head + 1) & TERMIOS_TX_MASK) != tx_tail) {
+    tx[tx_head] = buf[n++];
+    tx_head = (tx_head + 1) & TERMIOS_TX_MASK;
+  }
+  Drain();
+  return (n);
+}
@@ -0,0 +1,58 @@
+/*
+sqrl_termios.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_TERMIOS_H
+#define __SQRL_TERMIOS_H
+
+#include "Arduino.h"
+
+/**********************************************************
+  Stream over a Linux serial port
+
+  The port is opened non-blocking in the raw mode. The stream
+  never waits:
+  - Fill() moves the received bytes into the RX ring, it is
+    called when the fd is readable
+  - write() queues the bytes and writes what the port takes,
+    Drain() writes the rest when the fd is writable
+  - flush() does not wait for the transmission
+**********************************************************/
+
+// lengths of the rings, power of 2
+#define TERMIOS_RX_LEN      1024
+#define TERMIOS_TX_LEN      512
+
+class TermiosStream : public Stream {
+  private:
+    int fd;
+    byte rx[TERMIOS_RX_LEN];
+    uint16_t rx_head, rx_tail;
+    byte tx[TERMIOS_TX_LEN];
+    uint16_t tx_head, tx_tail;
+    uint16_t rx_dropped;
+
+  public:
+    TermiosStream(void);
+    ~TermiosStream(void);
+
+    int Open(const char *path, unsigned long baud);
+    void Close(void);
+    inline int Fd(void) {return fd;};
+    int Fill(void);
+    int Drain(void);
+    inline uint16_t TxPending(void) {return (tx_head - tx_tail) & (TERMIOS_TX_LEN - 1);};
+    inline uint16_t RxDropped(void) {return rx_dropped;};
+
+    // Stream
+    int available(void);
+    int read(void);
+    int peek(void);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t size);
+    using Print::write;
+};
+
+#endif
@@ -20,8 +20,144 @@ extern "C" {
 #undef PSTR
 #define PSTR(s) (__extension__({static prog_char __c[] PROGMEM = (s); &__c[0];}))
 
+// command table - strings and descriptors in PROGMEM
+#define AT_CMD_STR_ITEM(id, cmd, start_tmout, interchar_tmout, expected, attempts) \
+  static const char id##_str[] PROGMEM = cmd;
+#define AT_CMD_DESC_ITEM(id, cmd, start_tmout, interchar_tmout, expected, attempts) \
+  {id##_str, start_tmout, interchar_tmout, expected, attempts},
+#define AT_CMD_ALIAS_DESC_ITEM(id, same, start_tmout, interchar_tmout, expected, attempts) \
+  {same##_str, start_tmout, interchar_tmout, expected, attempts},
+#define AT_EXP_STR_ITEM(id, str, token) \
+  static const char id##_str[] PROGMEM = str;
+#define AT_EXP_PTR_ITEM(id, str, token) \
+  id##_str,
+#define AT_EXP_TOK_ITEM(id, str, token) \
+  token,
+
+// token table - keys in PROGMEM, slot --> token by the switch
+#define AT_TOK_STR_ITEM(id, key, slot) \
+  static const char id##_str[] PROGMEM = key;
+#define AT_TOK_PTR_ITEM(id, key, slot) \
+  id##_str,
+#define AT_TOK_CASE_ITEM(id, key, slot) \
+  case slot: return (id);
+
+AT_CMD_TABLE(AT_CMD_STR_ITEM)
+AT_EXP_TABLE(AT_EXP_STR_ITEM)
+AT_TOK_TABLE(AT_TOK_STR_ITEM)
+
+static const at_cmd_desc_t at_cmd_table[ATC_COUNT] PROGMEM = {
+  AT_CMD_TABLE(AT_CMD_DESC_ITEM)
+  AT_CMD_ALIAS_TABLE(AT_CMD_ALIAS_DESC_ITEM)
+};
+
+static const char * const at_exp_table[AT_EXP_COUNT] PROGMEM = {
+  AT_EXP_TABLE(AT_EXP_PTR_ITEM)
+};
+
+static const byte at_exp_tok_table[AT_EXP_COUNT] PROGMEM = {
+  AT_EXP_TABLE(AT_EXP_TOK_ITEM)
+};
+
+// indexed by the token, AT_TOK_NONE and AT_TOK_PROMPT have no key
+static const char * const at_tok_table[AT_TOK_COUNT] PROGMEM = {
+  NULL, NULL,
+  AT_TOK_TABLE(AT_TOK_PTR_ITEM)
+};
+
+static byte TokenOfSlot(byte slot)
+{
+  switch (slot) {
+    AT_TOK_TABLE(AT_TOK_CASE_ITEM)
+  }
+  return (AT_TOK_NONE);
+}
+
+/**********************************************************
+  Constructor
+
+  buf:      communication buffer of buf_size+1 characters,
+            see AtCommsBuffer<N> which provides it
+**********************************************************/
+AtComms::AtComms(byte *buf, byte buf_size) {
+  port = &Serial;
+  comm_buf = buf;
+  comm_buf_size = buf_size;
+  p_comm_buf = comm_buf;
+  comm_buf[0] = 0x00;
+  urc_handler_count = 0;
+  comm_buf_len = 0;
+  memset(resp_tokens, 0, sizeof(resp_tokens));
+  timing_key = AT_TIMING_NONE;
+  timing_slot = AT_TIMING_NONE;
+  ResetTiming();
+}
+
+static uint16_t TimingBound(unsigned long tmout, uint16_t min_tmout, uint16_t max_tmout)
+{
+  if (tmout < min_tmout) tmout = min_tmout;
+  if (tmout > max_tmout) tmout = max_tmout;
+  return ((uint16_t)tmout);
+}
+
+// avg += err/8, var += (|err| - var)/4 like the TCP RTO estimator
+static void TimingEwma(uint16_t &avg, uint16_t &var, uint16_t sample)
+{
+  long err = (long)sample - avg;
+
+  avg = (uint16_t)(avg + err / 8);
+  if (err < 0) err = -err;
+  var = (uint16_t)(var + (err - (long)var) / 4);
+}
+
+/**********************************************************
+Method forgets the latency history of all the commands, e.g.
+after the module was restarted or the baud rate changed
+**********************************************************/
+void AtComms::ResetTiming(void)
+{
+  byte i;
 
-AtComms::AtComms(void) {
+  for (i = 0; i < AT_TIMING_SLOTS; i++) {
+    timing[i].samples = 0;
+  }
+}
+
+/**********************************************************
+Method adds the finished reception to the history
+**********************************************************/
+void AtComms::TimingSample(void)
+{
+  at_timing_t *t;
+
+  if (timing_slot == AT_TIMING_NONE) return;
+  t = &timing[timing_slot];
+
+  if (t->samples == 0) {
+    t->srtt = rx_latency;
+    t->rttvar = rx_latency / 2;
+  }
+  else {
+    TimingEwma(t->srtt, t->rttvar, rx_latency);
+  }
+  if (t->samples < 255) t->samples++;
+  SQRL_LOG_NUM(SQRL_LOG_DEBUG, SQRL_LOG_TIME, F("latency"), rx_latency);
+}
+
+/**********************************************************
+Method doubles the estimate after a timeout or an unexpected
+response, so the next attempt waits longer (up to the static
+timeouts)
+**********************************************************/
+void AtComms::TimingBackoff(void)
+{
+  at_timing_t *t;
+
+  if (timing_slot == AT_TIMING_NONE) return;
+  t = &timing[timing_slot];
+
+  if (t->srtt < 0x7fff) t->srtt *= 2;
+  SQRL_LOG_NUM(SQRL_LOG_INFO, SQRL_LOG_TIME, F("backoff of key"), timing_slot + ATC_COUNT);
 }
 
 /**********************************************************
@@ -33,8 +169,26 @@ AtComms::AtComms(void) {
                         in msec.
   if there is no other incoming character longer then specified
   tmout(in msec) receiving process is considered as finished
+
+  if the key was set by UseTiming() and it has enough history
+  start_comm_tmout is shortened to the observed latency plus
+  four deviations, the passed one is the upper bound
 **********************************************************/
 void AtComms::RxInit(uint16_t start_comm_tmout, uint16_t max_interchar_tmout) {
+  at_timing_t *t;
+
+  timing_slot = AT_TIMING_NONE;
+  if (timing_key != AT_TIMING_NONE) {
+    timing_slot = timing_key - ATC_COUNT;
+    timing_key = AT_TIMING_NONE;
+    t = &timing[timing_slot];
+    if (t->samples >= AT_TIMING_SAMPLES) {
+      start_comm_tmout = TimingBound(t->srtt + 4UL * t->rttvar,
+                                     AT_TIMING_MIN_START, start_comm_tmout);
+    }
+  }
+  rx_latency = 0;
+
   rx_state = RX_NOT_STARTED;
   req_reception_tmout = start_comm_tmout;
   req_interchar_tmout = max_interchar_tmout;
@@ -42,7 +196,8 @@ void AtComms::RxInit(uint16_t start_comm_tmout, uint16_t max_interchar_tmout) {
   comm_buf[0] = 0x00; // end of string
   p_comm_buf = &comm_buf[0];
   comm_buf_len = 0;
-  Serial.flush(); // erase rx circular buffer
+  memset(resp_tokens, 0, sizeof(resp_tokens));
+  port->flush(); // erase rx circular buffer
 }
 
 void AtComms::ReadBuffer(char *into, int offset, int length) {
@@ -73,7 +228,7 @@ byte AtComms::IsRxFinished(void)
   // Rx state machine
 
   if (rx_state == RX_NOT_STARTED) { // Reception is not started yet - check tmout
-    if (!Serial.available()) { // still no character received => check timeout
+    if (!port->available()) { // still no character received => check timeout
       if ((unsigned long)(millis() - prev_time) >= req_reception_tmout) {
         comm_buf[comm_buf_len] = 0x00;
         ret_val = RX_TMOUT_ERR;
@@ -82,6 +237,7 @@ byte AtComms::IsRxFinished(void)
     else {
       // at least one character received => so init inter-character
       // counting process again and go to the next state
+      rx_latency = millis() - prev_time;
       prev_time = millis(); // init tmout for inter-character space
       rx_state = RX_ALREADY_STARTED;
     }
@@ -91,18 +247,20 @@ byte AtComms::IsRxFinished(void)
     // Reception already started
     // check new received bytes
     // only in case we have place in the buffer
-    num_of_bytes = Serial.available();
+    num_of_bytes = port->available();
     // if there are some received bytes postpone the timeout
-    if (num_of_bytes) prev_time = millis();
+    if (num_of_bytes) {
+      prev_time = millis();
+    }
 
     // read all received bytes
     while (num_of_bytes) {
       num_of_bytes--;
-      if (comm_buf_len < COMM_BUF_LEN) {
+      if (comm_buf_len < comm_buf_size) {
         // we have still place in the GSM internal comm. buffer =>
         // move available bytes from circular buffer
         // to the rx buffer
-        *p_comm_buf = Serial.read();
+        *p_comm_buf = port->read();
 
         p_comm_buf++;
         comm_buf_len++;
@@ -116,7 +274,7 @@ byte AtComms::IsRxFinished(void)
         // inter-character tmout is reached so just readout character from circular
         // RS232 buffer to find out when communication id finished
         // (no more characters are received in inter-char timeout)
-        Serial.read();
+        port->read();
       }
     }
 
@@ -131,6 +289,18 @@ byte AtComms::IsRxFinished(void)
 
   return (ret_val);
 }
+
+/**********************************************************
+Method returns millis() when IsRxFinished() finishes the
+reception if no other character is received - an event
+loop sleeps until then (see host/sqrl_gateway.h)
+**********************************************************/
+unsigned long AtComms::RxDeadline(void)
+{
+  if (rx_state == RX_NOT_STARTED) return (prev_time + req_reception_tmout);
+  return (prev_time + req_interchar_tmout);
+}
+
 /**********************************************************
 Method checks received bytes
 
@@ -142,18 +312,6 @@ return: 0 - string was NOT received
 byte AtComms::IsStringReceived(const __FlashStringHelper *compare_string)
 {
   if (comm_buf_len) {
-  
-		/*#ifdef DEBUG_GSMRX
-			Serial.println("DEBUG: Compare the string: ");
-			for (int i=0; i<comm_buf_len; i++){
-				Serial.write(byte(comm_buf[i]));	
-			}
-			
-			Serial.println("DEBUG: with the string: ");
-			Serial.print(compare_string);	
-			Serial.println(" ");
-		#endif*/
-	
 	if (strstr_P((char *)comm_buf, (const prog_char *)compare_string) != NULL) {
 	    return 1;
 	} 
@@ -161,6 +319,144 @@ byte AtComms::IsStringReceived(const __FlashStringHelper *compare_string)
 
     return 0;
 }
+/**********************************************************
+Method classifies one received line by its key, see
+AT_TOK_TABLE in sqrl_atcmd.h
+
+- the key is hashed and verified by one compare, so the line
+  is examined once whatever the num. of the tokens
+
+line: first character of the line (not finished by 0x00)
+len:  num. of characters available from line
+
+return: AT_TOK_xxx
+        AT_TOK_NONE - line is not in the table
+**********************************************************/
+byte AtComms::ClassifyLine(const char *line, byte len)
+{
+  byte key_len = 0;
+  byte token;
+  uint16_t h = AT_TOK_HASH_SEED;
+  const char *key;
+
+  if (len && line[0] == '>') return (AT_TOK_PROMPT);
+
+  // "<n>, <text>" - skip the connection number
+  if (len > 3 && line[0] >= '0' && line[0] <= '9' && line[1] == ',' && line[2] == ' ') {
+    line += 3;
+    len -= 3;
+  }
+
+  // find the end of the key and hash it
+  while (key_len < len) {
+    char c = line[key_len];
+
+    if (c == 0x0d || c == 0x0a) break;
+    if (line[0] == '+' && (c == ':' || c == ' ')) break;
+    if (key_len == AT_TOK_KEY_MAX) return (AT_TOK_NONE);
+    h = (h * 33) ^ (byte)c;
+    key_len++;
+  }
+  if (!key_len) return (AT_TOK_NONE);
+
+  token = TokenOfSlot((byte)(h ^ (h >> 8)) & (AT_TOK_SLOTS - 1));
+  if (token == AT_TOK_NONE) return (AT_TOK_NONE);
+
+  memcpy_P(&key, &at_tok_table[token], sizeof(key));
+  if (strlen_P(key) != key_len || strncmp_P(line, key, key_len) != 0) return (AT_TOK_NONE);
+  return (token);
+}
+
+/**********************************************************
+Method finds the first line of the comm buffer with the token
+
+return: pointer to the line in comm_buf
+        NULL - there is no such line
+**********************************************************/
+char *AtComms::FindToken(byte token)
+{
+  byte pos = 0;
+
+  if (!HasToken(token)) return (NULL);
+
+  while (pos < comm_buf_len) {
+    if (comm_buf[pos] != 0x0d && comm_buf[pos] != 0x0a
+        && ClassifyLine((const char *)&comm_buf[pos], comm_buf_len - pos) == token) {
+      return ((char *)&comm_buf[pos]);
+    }
+    while (pos < comm_buf_len && comm_buf[pos] != 0x0a) pos++;
+    pos++;
+  }
+  return (NULL);
+}
+
+/**********************************************************
+Method registers handler of unsolicited result codes
+Handlers are called in the order of registration for every
+line with a token received by WaitResp() or CheckResp()
+
+return: 0 - there is no free place for the handler
+        1 - handler was registered
+**********************************************************/
+byte AtComms::AddUrcHandler(at_urc_handler_t handler, void *context)
+{
+  if (urc_handler_count >= AT_URC_HANDLERS_MAX) return 0;
+  urc_handlers[urc_handler_count] = handler;
+  urc_contexts[urc_handler_count] = context;
+  urc_handler_count++;
+  return 1;
+}
+
+/**********************************************************
+Method classifies every line of the comm buffer and passes
+the lines with a token to the registered URC handlers
+
+- the tokens are collected for HasToken()
+- the comm buffer is not modified so the received response
+  can be still checked by the IsStringReceived() method
+- line which is not recognised by any handler is skipped
+**********************************************************/
+void AtComms::DispatchUrcs(void)
+{
+  byte pos = 0;
+  byte line_len;
+  byte used;
+  byte token;
+  byte i;
+
+  while (pos < comm_buf_len) {
+    if (comm_buf[pos] == 0x0d || comm_buf[pos] == 0x0a) {
+      // skip <CR><LF> between lines
+      pos++;
+      continue;
+    }
+
+    // length of the line including <CR><LF>
+    line_len = 0;
+    while (pos + line_len < comm_buf_len && comm_buf[pos + line_len] != 0x0a) line_len++;
+    if (pos + line_len < comm_buf_len) line_len++;
+
+    token = ClassifyLine((const char *)&comm_buf[pos], line_len);
+    if (token == AT_TOK_NONE) {
+      pos += line_len;
+      continue;
+    }
+    resp_tokens[token >> 3] |= 1 << (token & 7);
+
+    used = 0;
+    for (i = 0; i < urc_handler_count && !used; i++) {
+      used = urc_handlers[i](urc_contexts[i], token, (const char *)&comm_buf[pos], line_len);
+    }
+
+    if (used) {
+      if (used > comm_buf_len - pos) used = comm_buf_len - pos;
+      SQRL_LOG_DATA(SQRL_LOG_INFO, SQRL_LOG_URC, &comm_buf[pos], used);
+      pos += used;
+    }
+    else pos += line_len;
+  }
+}
+
 /**********************************************************
 Method waits for response
 
@@ -185,15 +481,19 @@ byte AtComms::WaitResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout)
     status = IsRxFinished();
   } while (status == RX_NOT_FINISHED);
 
-#ifdef DEBUG_GSMRX
-  if (status == RX_FINISHED){
-    for (int i=0; i<comm_buf_len; i++){
-      char c = comm_buf[i];
-      Serial.print(c);
+  if (status == RX_FINISHED) SQRL_LOG_DATA(SQRL_LOG_DEBUG, SQRL_LOG_RX, comm_buf, comm_buf_len);
+  else SQRL_LOG_NUM(SQRL_LOG_DEBUG, SQRL_LOG_TIME, F("no response in"), req_reception_tmout);
+
+  if (status == RX_FINISHED) {
+    DispatchUrcs();
+    // only a complete response is a sample, a cut one (e.g. by
+    // the inter-char. tmout) would shrink the estimate
+    if (HasToken(AT_TOK_OK) || HasToken(AT_TOK_ERROR) ||
+        HasToken(AT_TOK_CME_ERROR) || HasToken(AT_TOK_CMS_ERROR)) {
+      TimingSample();
     }
-    Serial.println();
   }
-#endif
+  else TimingBackoff();
 
   return (status);
 }
@@ -224,29 +524,30 @@ byte AtComms::WaitResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout,
     status = IsRxFinished();
   } while (status == RX_NOT_FINISHED);
 
-#ifdef DEBUG_GSMRX
-  if (status == RX_FINISHED){
-    for (int i=0; i<comm_buf_len; i++){
-      char c = comm_buf[i];
-      Serial.print(c);
-    }
-    Serial.println();
-  }
-#endif
+  if (status == RX_FINISHED) SQRL_LOG_DATA(SQRL_LOG_DEBUG, SQRL_LOG_RX, comm_buf, comm_buf_len);
+  else SQRL_LOG_NUM(SQRL_LOG_DEBUG, SQRL_LOG_TIME, F("no response in"), req_reception_tmout);
 
   if (status == RX_FINISHED) {
+    DispatchUrcs();
+
     // something was received but what was received?
 
     if(IsStringReceived(expected_resp_string)) {
       // expected string was received
       // ----------------------------
       ret_val = RX_FINISHED_STR_RECV;      
+      TimingSample();
+    }
+    else {
+      // e.g. the response was cut by too short timeout
+      ret_val = RX_FINISHED_STR_NOT_RECV;
+      TimingBackoff();
     }
-    else ret_val = RX_FINISHED_STR_NOT_RECV;
   }
   else {
     // nothing was received
     ret_val = RX_TMOUT_ERR;
+    TimingBackoff();
   }
   return (ret_val);
 }
@@ -264,6 +565,25 @@ eReq AtComms::SendCmd(
   req_reception_tmout = start_comm_tmout;
   req_interchar_tmout = max_interchar_tmout;
   req_attempts = no_of_attempts;
+  req_token = AT_TOK_NONE;
+
+  return SendCmdAttempt();
+}
+
+/**********************************************************
+Method sends the command from the table, CheckResp(void)
+then checks the expected token of the command
+**********************************************************/
+eReq AtComms::SendCmd(byte cmd)
+{
+  at_cmd_desc_t desc;
+
+  memcpy_P(&desc, &at_cmd_table[cmd], sizeof(desc));
+  req_cmd = (const __FlashStringHelper *)desc.cmd;
+  req_reception_tmout = desc.start_tmout;
+  req_interchar_tmout = desc.interchar_tmout;
+  req_attempts = desc.attempts;
+  req_token = pgm_read_byte(&at_exp_tok_table[desc.expected]);
 
   return SendCmdAttempt();
 }
@@ -271,9 +591,10 @@ eReq AtComms::SendCmd(
 //---
 eReq AtComms::SendCmdAttempt() {
   eReq rcode = REQ_FAIL;
-  req_attempts--;
   if (req_attempts > 0) {
-    Serial.println(req_cmd);
+    req_attempts--;
+    SQRL_LOG(SQRL_LOG_DEBUG, SQRL_LOG_TX, req_cmd);
+    port->println(req_cmd);
     RxInit(req_reception_tmout, req_interchar_tmout);
     rcode = REQ_OK;
   }
@@ -285,8 +606,10 @@ eResp AtComms::CheckResp(const __FlashStringHelper *response_string) {
   eResp rcode = RESP_WAIT;
   byte rx_state = IsRxFinished();
 
+  if (rx_state == RX_FINISHED) DispatchUrcs();
+
   if (rx_state == RX_FINISHED && 
-      IsStringReceived(response_string)) {
+      (response_string != NULL ? IsStringReceived(response_string) : HasToken(req_token))) {
     rcode = RESP_OK;
   }
   else if (rx_state != RX_NOT_FINISHED && 
@@ -311,26 +634,49 @@ char AtComms::SendATCmdWaitResp(
     uint16_t max_interchar_tmout,
     const __FlashStringHelper *response_string,
     byte no_of_attempts)
+{
+  return SendATCmdWaitResp(AT_cmd_string, start_comm_tmout, max_interchar_tmout,
+                           response_string, AT_TOK_NONE, no_of_attempts);
+}
+
+/**********************************************************
+Method sends AT command and waits for response, the response
+is checked by response_string or, if it is NULL, by the token
+of a response line
+**********************************************************/
+char AtComms::SendATCmdWaitResp(
+    const __FlashStringHelper *AT_cmd_string,
+    uint16_t start_comm_tmout,
+    uint16_t max_interchar_tmout,
+    const __FlashStringHelper *response_string,
+    byte response_token,
+    byte no_of_attempts)
 {
   byte status;
   char ret_val = AT_RESP_ERR_NO_RESP;
   byte i;
+  byte key = timing_key;  // every attempt is timed by the same key
 
   for (i = 0; i < no_of_attempts; i++) {
     // delay 500 msec. before sending next repeated AT command 
     // so if we have no_of_attempts=1 tmout will not occurred
     if (i > 0) delay(500); 
 
-    Serial.println(AT_cmd_string);
+    timing_key = key;
+    SQRL_LOG(SQRL_LOG_DEBUG, SQRL_LOG_TX, AT_cmd_string);
+    port->println(AT_cmd_string);
     status = WaitResp(start_comm_tmout, max_interchar_tmout); 
     if (status == RX_FINISHED) {
       // something was received but what was received?
       // ---------------------------------------------
-      if(IsStringReceived(response_string)) {
+      if (response_string != NULL ? IsStringReceived(response_string) : HasToken(response_token)) {
         ret_val = AT_RESP_OK;      
         break;  // response is OK => finish
       }
-      else ret_val = AT_RESP_ERR_DIF_RESP;
+      else {
+        ret_val = AT_RESP_ERR_DIF_RESP;
+        TimingBackoff();
+      }
     }
     else {
       // nothing was received
@@ -342,3 +688,47 @@ char AtComms::SendATCmdWaitResp(
 
   return (ret_val);
 }
+
+/**********************************************************
+Method sends the AT command from the command table and waits
+for the response, timeouts, expected response and num. of
+attempts are taken from the table (see sqrl_atcmd.h)
+- the expected response is checked by the token of the line
+
+cmd: ATC_xxx
+
+return: see SendATCmdWaitResp() above
+**********************************************************/
+char AtComms::SendATCmdWaitResp(byte cmd)
+{
+  at_cmd_desc_t desc;
+
+  memcpy_P(&desc, &at_cmd_table[cmd], sizeof(desc));
+  return SendATCmdWaitResp((const __FlashStringHelper *)desc.cmd,
+                           desc.start_tmout, desc.interchar_tmout,
+                           NULL, pgm_read_byte(&at_exp_tok_table[desc.expected]),
+                           desc.attempts);
+}
+
+/**********************************************************
+Method returns the string of the command from the table
+**********************************************************/
+const __FlashStringHelper *AtComms::CmdString(byte cmd)
+{
+  const char *p;
+
+  memcpy_P(&p, &at_cmd_table[cmd].cmd, sizeof(p));
+  return (const __FlashStringHelper *)p;
+}
+
+/**********************************************************
+Method returns the expected response string, e.g. for
+WaitResp() after a command with parameters
+**********************************************************/
+const __FlashStringHelper *AtComms::ExpString(byte expected)
+{
+  const char *p;
+
+  memcpy_P(&p, &at_exp_table[expected], sizeof(p));
+  return (const __FlashStringHelper *)p;
+}
@@ -9,21 +9,58 @@ This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt fi
 
 #include "Arduino.h"
 #include <avr/pgmspace.h>
-
-// if defined - debug print is enabled with possibility to print out 
-// debug texts to the terminal program
-#define DEBUG_PRINT
-
-// if defined - debug print is enabled with possibility to print out 
-// the data recived from gsm module
-#define DEBUG_GSMRX
+#include "sqrl_atcmd.h"
+#include "sqrl_ram.h"
+#include "sqrl_log.h"
 
 // some constants for the IsRxFinished() method
 #define RX_NOT_STARTED      0
 #define RX_ALREADY_STARTED  1
 
-// length for the internal communication buffer
+// length of the communication buffer of GSM(void), other lengths
+// are selected by AtCommsBuffer<N> or SizedGSM<N>
+#ifndef COMM_BUF_LEN
 #define COMM_BUF_LEN        200
+#endif
+// limits of the comm buffer length
+// - min.: +CGPSINF record, headers of +HTTPREAD and +CIPRXGET with data
+// - max.: positions in the buffer are byte
+#define AT_COMM_BUF_MIN     96
+#define AT_COMM_BUF_MAX     250
+
+// max. number of URC handlers attached to the comm line
+#define AT_URC_HANDLERS_MAX 4
+
+/**********************************************************
+  Adaptive timeouts
+
+  at.UseTiming(key) before WaitResp() or SendATCmdWaitResp()
+  keys the reception by the command (ATT_xxx), every key has
+  its own history. The time to the first character is tracked
+  as the average and the deviation (like the TCP RTO). Once
+  there are AT_TIMING_SAMPLES the start timeout is the average
+  plus four deviations, within AT_TIMING_MIN_START and the
+  static timeout passed by the caller. A timeout or an
+  unexpected response doubles the average, so the retries fall
+  back to the static timeout.
+
+  The inter-character timeout is always the static one - it
+  ends the response, a shorter one would cut long responses
+  (e.g. a listing of AT+CMGL after some empty ones).
+**********************************************************/
+#define AT_TIMING_SLOTS     (ATT_COUNT - ATC_COUNT)
+#define AT_TIMING_NONE      0xff
+#define AT_TIMING_SAMPLES   4     // min. num. of samples before the timeout is adapted
+#define AT_TIMING_MIN_START 100   // lower bound of the adapted start_comm_tmout (msec.)
+
+enum comm_line_status_enum 
+{
+  // CLS like CommunicationLineStatus
+  CLS_FREE,   // line is free - not used by the communication and can be used
+  CLS_ATCMD,  // line is used by AT commands, includes also time for response
+  CLS_DATA,  // line is used as a raw data pipe of the GPRS connection (see IpPipe)
+  CLS_GPS    // line is switched to the GPS UART streaming NMEA (see GSM::StartNmea)
+};
 
 enum rx_state_enum 
 {
@@ -42,10 +79,35 @@ enum at_resp_enum
 };
 
 enum eReq { REQ_FAIL, REQ_OK };
+
+// latency history of one command, all in msec.
+struct at_timing_t {
+  byte samples;
+  uint16_t srtt;        // smoothed time to the first character
+  uint16_t rttvar;      // its mean deviation
+};
+
+/**********************************************************
+  Handler of unsolicited result codes (URCs)
+
+  Handlers are called only for the lines with a token,
+  see AT_TOK_TABLE in sqrl_atcmd.h
+
+  context - pointer registered together with the handler
+  token   - AT_TOK_xxx of the line
+  line    - first character of a received line in comm_buf
+            (line is NOT finished by 0x00)
+  len     - num. of characters of the line including <CR><LF>
+
+  return: num. of characters consumed by the handler,
+          0 - line was not recognised
+**********************************************************/
+typedef byte (*at_urc_handler_t)(void *context, byte token, const char *line, byte len);
 enum eResp { RESP_WAIT, RESP_FAIL, RESP_OK };
 
 class AtComms {
   private:
+    Stream *port;                   // UART of the module, Serial by default
     byte comm_line_status;
 
     byte rx_state;                  // internal state of rx state machine
@@ -54,31 +116,74 @@ class AtComms {
     uint16_t req_reception_tmout;
     uint16_t req_interchar_tmout;
     byte req_attempts;
+    byte req_token;                 // token expected by CheckResp(void)
+
+    at_urc_handler_t urc_handlers[AT_URC_HANDLERS_MAX];
+    void *urc_contexts[AT_URC_HANDLERS_MAX];
+    byte urc_handler_count;
+
+    byte resp_tokens[AT_TOK_SET_LEN]; // tokens of the lines in comm_buf
+
+    at_timing_t timing[AT_TIMING_SLOTS]; // indexed by ATT_xxx - ATC_COUNT
+    byte timing_key;                // key for the next reception
+    byte timing_slot;               // slot of the current reception
+    uint16_t rx_latency;            // time to the first character
 
     void RxInit(uint16_t start_comm_tmout, uint16_t max_interchar_tmout);
+    void TimingSample(void);
+    void TimingBackoff(void);
     eReq SendCmdAttempt(void);
+    char SendATCmdWaitResp(
+        const __FlashStringHelper *AT_cmd_string,
+        uint16_t start_comm_tmout,
+        uint16_t max_interchar_tmout,
+        const __FlashStringHelper *response_string,
+        byte response_token,
+        byte no_of_attempts);
 
   public:
-    AtComms(void);
+    AtComms(byte *buf, byte buf_size);
 
-    byte comm_buf[COMM_BUF_LEN+1];  // communication buffer +1 for 0x00 termination
+    byte *comm_buf;                 // communication buffer, buf_size+1 for 0x00 termination
     byte *p_comm_buf;               // pointer to the communication buffer
     byte comm_buf_len;              // num. of characters in the buffer
+    byte comm_buf_size;             // max. num. of characters in the buffer
+
+    // transport - e.g. Serial1, TraceStream or ReplayStream (see sqrl_trace.h)
+    inline void SetPort(Stream *new_port) {port = new_port;};
+    inline Stream &Port(void) {return *port;};
 
     // util
     inline void SetCommLineStatus(byte new_status) {comm_line_status = new_status;};
     inline byte GetCommLineStatus(void) {return comm_line_status;};
     void ReadBuffer(char *into, int offset, int length);
     byte IsRxFinished(void);
+    inline void StartRx(uint16_t start_comm_tmout, uint16_t max_interchar_tmout) {RxInit(start_comm_tmout, max_interchar_tmout);};
+    unsigned long RxDeadline(void);
     byte IsStringReceived(const __FlashStringHelper *compare_string);
 
+    // response lines
+    static byte ClassifyLine(const char *line, byte len);
+    inline byte HasToken(byte token) {return (resp_tokens[token >> 3] >> (token & 7)) & 1;};
+    char *FindToken(byte token);
+
+    // adaptive timeouts
+    inline void UseTiming(byte key) {timing_key = key;};
+    void ResetTiming(void);
+
+    // URCs
+    byte AddUrcHandler(at_urc_handler_t handler, void *context);
+    void DispatchUrcs(void);
+
     // async
     eReq SendCmd(
         const __FlashStringHelper *AT_cmd_string,
         uint16_t start_comm_tmout,
         uint16_t max_interchar_tmout,
         byte no_of_attempts);
+    eReq SendCmd(byte cmd);
     eResp CheckResp(const __FlashStringHelper *response_string);
+    inline eResp CheckResp(void) {return CheckResp(NULL);};
 
     // sync
     byte WaitResp(uint16_t start_comm_tmout, uint16_t max_interchar_tmout);
@@ -89,6 +194,28 @@ class AtComms {
         uint16_t max_interchar_tmout,
         const __FlashStringHelper *response_string,
         byte no_of_attempts);
+    char SendATCmdWaitResp(byte cmd);
+
+    // command table - see sqrl_atcmd.h
+    static const __FlashStringHelper *CmdString(byte cmd);
+    static const __FlashStringHelper *ExpString(byte expected);
+};
+
+/**********************************************************
+  AtComms with its own comm buffer of N characters
+
+  The length is checked at compile time, e.g.
+    AtCommsBuffer<128> comms;
+**********************************************************/
+template <unsigned int N>
+class AtCommsBuffer : public AtComms {
+  private:
+    SQRL_STATIC_ASSERT(N >= AT_COMM_BUF_MIN, comm_buf_too_short);
+    SQRL_STATIC_ASSERT(N <= AT_COMM_BUF_MAX, comm_buf_too_long);
+    byte buf[N + 1];
+
+  public:
+    AtCommsBuffer(void) : AtComms(buf, N) {};
 };
 
 #endif
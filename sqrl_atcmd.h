@@ -0,0 +1,221 @@
+/*
+sqrl_atcmd.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_ATCMD_H
+#define __SQRL_ATCMD_H
+
+#include "Arduino.h"
+
+/**********************************************************
+  Table of the fixed AT commands
+
+  Every command the library sends without parameters is
+  described here once: the command string, the timeouts,
+  the expected response and the num. of attempts. The table
+  is kept in PROGMEM and the commands are referenced by the
+  ATC_xxx ids, e.g. at.SendATCmdWaitResp(ATC_CMGF_TEXT).
+
+  This is the one place where the timeouts can be tuned to
+  the network and the module firmware of a deployment.
+
+  X(id, command, start_tmout, interchar_tmout, expected, attempts)
+    start_tmout     - max. time for the first character (msec.)
+    interchar_tmout - max. time between characters (msec.)
+    expected        - AT_EXP_xxx
+**********************************************************/
+#define AT_CMD_TABLE(X) \
+  /* general */ \
+  X(ATC_AT,             "AT",                               900,   200,  AT_EXP_OK,       5) \
+  X(ATC_IPR,            "AT+IPR=9600",                      500,   50,   AT_EXP_OK,       5) \
+  X(ATC_FACTORY,        "AT&F",                             1000,  50,   AT_EXP_OK,       5) \
+  X(ATC_ECHO_OFF,       "ATE0",                             500,   50,   AT_EXP_OK,       5) \
+  X(ATC_CMEE,           "AT+CMEE=0",                        500,   50,   AT_EXP_OK,       5) \
+  X(ATC_CCID,           "AT+CCID",                          500,   50,   AT_EXP_OK,       5) \
+  /* network */ \
+  X(ATC_CREG_LOC,       "AT+CREG=2",                        500,   50,   AT_EXP_OK,       5) \
+  X(ATC_CREG_QUERY,     "AT+CREG?",                         5000,  200,  AT_EXP_OK,       2) \
+  X(ATC_CSQ,            "AT+CSQ",                           500,   50,   AT_EXP_OK,       1) \
+  X(ATC_COPS,           "AT+COPS?",                         1000,  50,   AT_EXP_OK,       1) \
+  /* calls */ \
+  X(ATC_CLIP,           "AT+CLIP=1",                        500,   50,   AT_EXP_OK,       5) \
+  X(ATC_CRC,            "AT+CRC=1",                         500,   50,   AT_EXP_OK,       5) \
+  X(ATC_CLCC,           "AT+CLCC",                          5000,  1500, AT_EXP_OK_CRLF,  1) \
+  X(ATC_ANSWER,         "ATA",                              1000,  100,  AT_EXP_OK,       2) \
+  X(ATC_HANGUP,         "ATH",                              1000,  100,  AT_EXP_OK,       2) \
+  /* SMS, phonebook */ \
+  X(ATC_CMGF_TEXT,      "AT+CMGF=1",                        500,   50,   AT_EXP_OK,       5) \
+  X(ATC_CNMI,           "AT+CNMI=2,0",                      1000,  50,   AT_EXP_OK,       2) \
+  X(ATC_CPMS_SIM,       "AT+CPMS=\"SM\",\"SM\"",            1000,  1000, AT_EXP_CPMS,     10) \
+  X(ATC_CPBS_SIM,       "AT+CPBS=\"SM\"",                   1000,  50,   AT_EXP_OK,       5) \
+  /* bearer, HTTP */ \
+  X(ATC_SAPBR_APN,      "AT+SAPBR=3,1,\"APN\",\"internet\"", 900,  500,  AT_EXP_OK,       2) \
+  X(ATC_SAPBR_GPRS,     "AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"", 900,  500,  AT_EXP_OK,       2) \
+  X(ATC_SAPBR_QUERY,    "AT+SAPBR=2,1",                     900,   900,  AT_EXP_OK,       5) \
+  X(ATC_SAPBR_OPEN,     "AT+SAPBR=1,1",                     20000, 900,  AT_EXP_OK,       5) \
+  X(ATC_SAPBR_CLOSE,    "AT+SAPBR=0,1",                     900,   500,  AT_EXP_OK,       2) \
+  X(ATC_HTTPINIT,       "AT+HTTPINIT",                      900,   500,  AT_EXP_OK,       2) \
+  X(ATC_HTTPTERM,       "AT+HTTPTERM",                      900,   500,  AT_EXP_OK,       2) \
+  X(ATC_HTTPPARA_CID,   "AT+HTTPPARA=\"CID\",\"1\"",        900,   500,  AT_EXP_OK,       5) \
+  /* TCP/IP */ \
+  X(ATC_CIICR,          "AT+CIICR",                         30000, 100,  AT_EXP_OK,       1) \
+  X(ATC_CIPSHUT,        "AT+CIPSHUT",                       5000,  100,  AT_EXP_SHUT_OK,  2) \
+  X(ATC_CIPMUX_MULTI,   "AT+CIPMUX=1",                      900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CIPMUX_SINGLE,  "AT+CIPMUX=0",                      900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CIPRXGET,       "AT+CIPRXGET=1",                    900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CIPQSEND,       "AT+CIPQSEND=1",                    900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CIPMODE_TRANS,  "AT+CIPMODE=1",                     900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CIPMODE_NORMAL, "AT+CIPMODE=0",                     900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CIPCLOSE_QUICK, "AT+CIPCLOSE=1",                    2000,  100,  AT_EXP_CLOSE_OK, 1) \
+  X(ATC_ATO,            "ATO",                              2000,  100,  AT_EXP_CONNECT,  1) \
+  /* GPS */ \
+  X(ATC_CGPSIPR,        "AT+CGPSIPR=9600",                  1200,  100,  AT_EXP_OK,       5) \
+  X(ATC_CGPSOUT_OFF,    "AT+CGPSOUT=0",                     1200,  100,  AT_EXP_OK,       5) \
+  X(ATC_CGPSPWR_ON,     "AT+CGPSPWR=1",                     1200,  100,  AT_EXP_OK,       5) \
+  X(ATC_CGPSPWR_OFF,    "AT+CGPSPWR=0",                     2000,  100,  AT_EXP_OK,       5) \
+  X(ATC_CGPSRST_COLD,   "AT+CGPSRST=0",                     1200,  100,  AT_EXP_OK,       5) \
+  X(ATC_CGPSRST_HOT,    "AT+CGPSRST=1",                     1200,  100,  AT_EXP_OK,       5) \
+  X(ATC_CGPSRST_WARM,   "AT+CGPSRST=2",                     1200,  100,  AT_EXP_OK,       5) \
+  X(ATC_CGPS_QUERY,     "AT+CGPSSTATUS?;+CGPSINF=0",        900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CGPSSTATUS,     "AT+CGPSSTATUS?",                   900,   50,   AT_EXP_OK,       2) \
+  X(ATC_CGPSINF,        "AT+CGPSINF=0",                     900,   50,   AT_EXP_OK,       2)
+
+// commands sending the string of a command above with other
+// timeouts or attempts, the string is not stored twice
+// X(id, same string as, start_tmout, interchar_tmout, expected, attempts)
+#define AT_CMD_ALIAS_TABLE(X) \
+  X(ATC_AT_PING,        ATC_AT,                             200,   50,   AT_EXP_OK,       2)
+
+// expected responses, X(id, string, token of the response line)
+#define AT_EXP_TABLE(X) \
+  X(AT_EXP_OK,          "OK",         AT_TOK_OK) \
+  X(AT_EXP_OK_CRLF,     "OK\r\n",     AT_TOK_OK) \
+  X(AT_EXP_CPMS,        "+CPMS:",     AT_TOK_CPMS) \
+  X(AT_EXP_SHUT_OK,     "SHUT OK",    AT_TOK_SHUT_OK) \
+  X(AT_EXP_CLOSE_OK,    "CLOSE OK",   AT_TOK_CLOSE_OK) \
+  X(AT_EXP_CONNECT,     "CONNECT",    AT_TOK_CONNECT)
+
+/**********************************************************
+  Table of the response line tokens
+
+  Every received line is classified once by its key:
+  - "+XXX: ..." lines - the text up to ':' or ' ', e.g. "+CREG"
+  - other lines       - the whole line, e.g. "NO CARRIER"
+  - "<n>, <text>"     - the connection number is skipped and
+                        <text> is the key, e.g. "0, CLOSED"
+  - ">"               - AT_TOK_PROMPT (not in the table)
+
+  The key is hashed by AtComms::ClassifyLine():
+    h = AT_TOK_HASH_SEED
+    for every character c: h = (h * 33) ^ c     (16 bits)
+    slot = (h ^ (h >> 8)) & (AT_TOK_SLOTS - 1)
+  and the slot selects the token, the key is then verified by
+  a single compare. The slots were found off-line so that no
+  two keys share a slot - a duplicate slot is reported by the
+  compiler as a duplicate case value. When a key is added its
+  slot must be computed by the formula above.
+
+  X(id, key, slot)
+**********************************************************/
+#define AT_TOK_TABLE(X) \
+  X(AT_TOK_OK,              "OK",                   62) \
+  X(AT_TOK_ERROR,           "ERROR",               101) \
+  X(AT_TOK_CME_ERROR,       "+CME",                 63) \
+  X(AT_TOK_CMS_ERROR,       "+CMS",                 41) \
+  X(AT_TOK_RING,            "RING",                 76) \
+  X(AT_TOK_NO_CARRIER,      "NO CARRIER",           50) \
+  X(AT_TOK_BUSY,            "BUSY",                 49) \
+  X(AT_TOK_NO_ANSWER,       "NO ANSWER",            55) \
+  X(AT_TOK_NO_DIALTONE,     "NO DIALTONE",         103) \
+  X(AT_TOK_CONNECT,         "CONNECT",              39) \
+  X(AT_TOK_CONNECT_OK,      "CONNECT OK",          116) \
+  X(AT_TOK_CONNECT_FAIL,    "CONNECT FAIL",         98) \
+  X(AT_TOK_ALREADY_CONNECT, "ALREADY CONNECT",      26) \
+  X(AT_TOK_CLOSED,          "CLOSED",              113) \
+  X(AT_TOK_CLOSE_OK,        "CLOSE OK",             19) \
+  X(AT_TOK_SHUT_OK,         "SHUT OK",              17) \
+  X(AT_TOK_SEND_OK,         "SEND OK",              74) \
+  X(AT_TOK_SEND_FAIL,       "SEND FAIL",           109) \
+  X(AT_TOK_DOWNLOAD,        "DOWNLOAD",             85) \
+  X(AT_TOK_CALL_READY,      "Call Ready",           90) \
+  X(AT_TOK_POWER_DOWN,      "NORMAL POWER DOWN",    59) \
+  X(AT_TOK_CREG,            "+CREG",               102) \
+  X(AT_TOK_CSQ,             "+CSQ",                117) \
+  X(AT_TOK_COPS,            "+COPS",               118) \
+  X(AT_TOK_CPIN,            "+CPIN",                73) \
+  X(AT_TOK_CLIP,            "+CLIP",                94) \
+  X(AT_TOK_CRING,           "+CRING",               43) \
+  X(AT_TOK_CLCC,            "+CLCC",                 0) \
+  X(AT_TOK_CPAS,            "+CPAS",                95) \
+  X(AT_TOK_CMTI,            "+CMTI",                82) \
+  X(AT_TOK_CMGR,            "+CMGR",                56) \
+  X(AT_TOK_CMGL,            "+CMGL",                38) \
+  X(AT_TOK_CMGS,            "+CMGS",                57) \
+  X(AT_TOK_CPMS,            "+CPMS",                80) \
+  X(AT_TOK_CPBR,            "+CPBR",               125) \
+  X(AT_TOK_CCLK,            "+CCLK",                 3) \
+  X(AT_TOK_SAPBR,           "+SAPBR",              119) \
+  X(AT_TOK_HTTPACTION,      "+HTTPACTION",          93) \
+  X(AT_TOK_HTTPREAD,        "+HTTPREAD",            14) \
+  X(AT_TOK_CIPRXGET,        "+CIPRXGET",            51) \
+  X(AT_TOK_PDP,             "+PDP",                 33) \
+  X(AT_TOK_CGPSSTATUS,      "+CGPSSTATUS",          11) \
+  X(AT_TOK_CGPSINF,         "+CGPSINF",              6)
+
+#define AT_TOK_HASH_SEED    40
+#define AT_TOK_SLOTS        128
+#define AT_TOK_KEY_MAX      17    // longest key, longer lines are not classified
+
+#define AT_CMD_ENUM_ITEM(id, cmd, start_tmout, interchar_tmout, expected, attempts) id,
+#define AT_EXP_ENUM_ITEM(id, str, token) id,
+#define AT_TOK_ENUM_ITEM(id, key, slot) id,
+
+enum at_cmd_enum {
+  AT_CMD_TABLE(AT_CMD_ENUM_ITEM)
+  AT_CMD_ALIAS_TABLE(AT_CMD_ENUM_ITEM)
+  ATC_COUNT
+};
+
+// timing keys of the commands with a latency history, they follow
+// the ATC_xxx ids - see AtComms::UseTiming()
+enum at_timing_enum {
+  ATT_CREG = ATC_COUNT,   // AT+CREG?
+  ATT_CPAS,               // AT+CPAS
+  ATT_CMGL,               // AT+CMGL=...
+  ATT_CMGR,               // AT+CMGR=<n>
+  ATT_CMGS,               // +CMGS after the SMS text
+  ATT_CPBR,               // AT+CPBR=<n>
+  ATT_CCLK,               // AT+CCLK?
+  ATT_HTTPACTION,         // +HTTPACTION after OK
+  ATT_HTTPREAD,           // AT+HTTPREAD=<offset>,<len>
+  ATT_CIPRXGET,           // AT+CIPRXGET=2,<n>,<len>
+  ATT_COUNT
+};
+
+enum at_exp_enum {
+  AT_EXP_TABLE(AT_EXP_ENUM_ITEM)
+  AT_EXP_COUNT
+};
+
+enum at_tok_enum {
+  AT_TOK_NONE = 0,    // line is not in the table
+  AT_TOK_PROMPT,      // "> " - module waits for the data
+  AT_TOK_TABLE(AT_TOK_ENUM_ITEM)
+  AT_TOK_COUNT
+};
+
+// size of the set of tokens received in one response
+#define AT_TOK_SET_LEN      ((AT_TOK_COUNT + 7) / 8)
+
+// one item of the table in PROGMEM
+struct at_cmd_desc_t {
+  const char *cmd;              // PROGMEM string
+  uint16_t start_tmout;
+  uint16_t interchar_tmout;
+  byte expected;                // at_exp_enum
+  byte attempts;
+};
+
+#endif
@@ -0,0 +1,329 @@
+/*
+sqrl_batch.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_batch.h"
+
+extern "C" {
+  #include <string.h>
+}
+
+// LZSS parameters
+#define LZSS_MIN_MATCH      3
+#define LZSS_MAX_MATCH      (LZSS_MIN_MATCH + 15)
+#define LZSS_WINDOW         4096
+
+TelemetryBatch::TelemetryBatch(void) {
+  format = BATCH_LZSS;
+  Clear();
+}
+
+/**********************************************************
+Method appends the record to the batch
+
+record: record data
+len:    num. of bytes of the record <1..255>
+
+return: 0 - there is not enough place - flush the batch first
+        1 - record was added
+**********************************************************/
+byte TelemetryBatch::Add(const byte *record, byte len)
+{
+  if (len == 0 || used + 1 + len > BATCH_ARENA_LEN) return 0;
+
+  if (records == 0) first_at = millis();
+  arena[used++] = len;
+  memcpy(&arena[used], record, len);
+  used += len;
+  records++;
+  return 1;
+}
+
+byte TelemetryBatch::Add(const char *record)
+{
+  size_t len = strlen(record);
+
+  if (len > 255) return 0;
+  return Add((const byte *)record, (byte)len);
+}
+
+void TelemetryBatch::Clear(void)
+{
+  used = 0;
+  records = 0;
+  first_at = 0;
+  Rewind();
+}
+
+/**********************************************************
+Method finds out if the batch should be sent now
+
+rssi_avg: average signal quality (GSM::GetSignalAvg())
+          NET_RSSI_UNKNOWN - signal is not taken into account
+
+return: 0 - keep collecting
+        1 - send the batch - it is almost full, too old or
+            the signal is good and it is worth to send it
+**********************************************************/
+byte TelemetryBatch::ShouldFlush(byte rssi_avg)
+{
+  if (records == 0) return 0;
+  if (used >= BATCH_FULL_LEN) return 1;
+  if ((unsigned long)(millis() - first_at) >= BATCH_MAX_AGE) return 1;
+  if (rssi_avg >= BATCH_GOOD_RSSI && rssi_avg <= 31 && used >= BATCH_GOOD_LEN) return 1;
+  return 0;
+}
+
+/**********************************************************
+Method starts reading of the body from the beginning
+**********************************************************/
+void TelemetryBatch::Rewind(void)
+{
+  rd_pos = 0;
+  rd_group_len = 0;
+  rd_group_pos = 0;
+  rd_header = 1;
+  rd_frame = 0;
+}
+
+/**********************************************************
+Method encodes next LZSS group (max. 8 items) from rd_pos
+
+control byte: bit i (LSB first) 1 - item i is a literal byte
+                                0 - item i is a match of 2 bytes
+match: d = distance - 1 (12 bits), l = length - LZSS_MIN_MATCH
+       <d >> 4> <(d & 0x0f) << 4 | l>
+**********************************************************/
+void TelemetryBatch::EncodeGroup(void)
+{
+  byte item;
+  byte control = 0;
+  uint16_t start;
+  uint16_t j;
+  uint16_t best_len;
+  uint16_t best_dist;
+  uint16_t len;
+  uint16_t max_len;
+
+  rd_group_len = 1;
+  rd_group_pos = 0;
+
+  for (item = 0; item < 8 && rd_pos < used; item++) {
+    // find the longest match in the window
+    best_len = 0;
+    best_dist = 0;
+    max_len = used - rd_pos;
+    if (max_len > LZSS_MAX_MATCH) max_len = LZSS_MAX_MATCH;
+    start = (rd_pos > LZSS_WINDOW) ? rd_pos - LZSS_WINDOW : 0;
+
+    if (max_len >= LZSS_MIN_MATCH) {
+      for (j = start; j < rd_pos; j++) {
+        if (arena[j] != arena[rd_pos]) continue;
+        // match can overlap the current position
+        for (len = 1; len < max_len && arena[j + len] == arena[rd_pos + len]; len++);
+        if (len > best_len) {
+          best_len = len;
+          best_dist = rd_pos - j;
+          if (len == max_len) break;
+        }
+      }
+    }
+
+    if (best_len >= LZSS_MIN_MATCH) {
+      rd_group[rd_group_len++] = (best_dist - 1) >> 4;
+      rd_group[rd_group_len++] = (((best_dist - 1) & 0x0f) << 4) | (best_len - LZSS_MIN_MATCH);
+      rd_pos += best_len;
+    }
+    else {
+      control |= (1 << item);
+      rd_group[rd_group_len++] = arena[rd_pos++];
+    }
+  }
+
+  rd_group[0] = control;
+}
+
+/**********************************************************
+Method reads the next part of the body
+
+return: num. of bytes placed into buf, 0 - end of the body
+**********************************************************/
+uint16_t TelemetryBatch::Read(byte *buf, uint16_t max_len)
+{
+  uint16_t n = 0;
+  uint16_t part;
+
+  if (rd_header && max_len) {
+    buf[n++] = format;
+    rd_header = 0;
+  }
+
+  while (n < max_len) {
+    if (format == BATCH_RAW) {
+      part = used - rd_pos;
+      if (part > max_len - n) part = max_len - n;
+      if (part == 0) break;
+      memcpy(buf + n, &arena[rd_pos], part);
+      rd_pos += part;
+      n += part;
+    }
+    else {
+      if (rd_group_pos == rd_group_len) {
+        if (rd_pos >= used) break;
+        EncodeGroup();
+      }
+      buf[n++] = rd_group[rd_group_pos++];
+    }
+  }
+  return n;
+}
+
+/**********************************************************
+Method computes the length of the body
+- the compressed body is encoded once only to get its length
+  (there is no place to keep it) so it is slower than Read()
+
+reading is rewound
+**********************************************************/
+long TelemetryBatch::BodyLength(void)
+{
+  long len = 1;
+
+  Rewind();
+  if (format == BATCH_RAW) return (1 + used);
+
+  rd_header = 0;
+  while (rd_pos < used) {
+    EncodeGroup();
+    len += rd_group_len;
+  }
+  Rewind();
+  return len;
+}
+
+/**********************************************************
+Source of the body for the HttpSession::Post()
+context: pointer to the TelemetryBatch
+**********************************************************/
+uint16_t TelemetryBatch::Source(void *context, char *buf, uint16_t max_len)
+{
+  if (buf == NULL) {
+    // request is repeated
+    ((TelemetryBatch *)context)->Rewind();
+    return 1;
+  }
+  return ((TelemetryBatch *)context)->Read((byte *)buf, max_len);
+}
+
+/**********************************************************
+Methods send the batch by one request and clear it when
+it was sent
+
+return: 0 - batch was not sent and is kept
+        1 - batch was sent
+**********************************************************/
+byte TelemetryBatch::Flush(HttpSession &http, const char *url)
+{
+  long len;
+
+  if (records == 0) return 1;
+  len = BodyLength();
+  if (HTTP_OK != http.Post(url, F("application/octet-stream"), len, Source, this, NULL, NULL)) {
+    Rewind();
+    return 0;
+  }
+  Clear();
+  return 1;
+}
+
+/**********************************************************
+Source of the frame for the IpSockets::Send()
+<length of the body, 2 bytes big endian><body>
+context: pointer to the TelemetryBatch
+**********************************************************/
+uint16_t TelemetryBatch::FrameSource(void *context, char *buf, uint16_t max_len)
+{
+  TelemetryBatch *batch = (TelemetryBatch *)context;
+  uint16_t n = 0;
+
+  while (batch->rd_frame && n < max_len) {
+    buf[n++] = (batch->rd_frame == 2) ? batch->rd_frame_len >> 8 : batch->rd_frame_len & 0xff;
+    batch->rd_frame--;
+  }
+  return (n + batch->Read((byte *)buf + n, max_len - n));
+}
+
+/**********************************************************
+Method sends the batch over the connection as one frame
+- the frame is sent by one AT+CIPSEND (by more ones of
+  IP_SEND_MAX only if it is longer), the bytes are read from
+  the arena directly
+- if sending fails the connection is closed - a part of the
+  frame may be sent and the receiver would lose the framing
+
+return: 0 - batch was not sent and is kept
+        1 - batch was sent
+**********************************************************/
+byte TelemetryBatch::Flush(IpSockets &sockets, byte id)
+{
+  long left;
+  uint16_t n;
+
+  if (records == 0) return 1;
+
+  rd_frame_len = BodyLength();
+  rd_frame = 2;
+  left = rd_frame_len + 2;
+  while (left > 0) {
+    n = (left > IP_SEND_MAX) ? IP_SEND_MAX : left;
+    if (sockets.Send(id, n, FrameSource, this) != (int)n) {
+      // part of the frame may be on the way
+      if (sockets.GetState(id) == CONN_CONNECTED) sockets.Close(id);
+      Rewind();
+      return 0;
+    }
+    left -= n;
+  }
+  Clear();
+  return 1;
+}
+
+/**********************************************************
+Function decodes LZSS stream created by the TelemetryBatch
+(without the format byte)
+
+return: num. of bytes placed into out
+**********************************************************/
+uint16_t LzssDecode(const byte *in, uint16_t in_len, byte *out, uint16_t max_len)
+{
+  uint16_t i = 0;
+  uint16_t n = 0;
+  uint16_t dist;
+  byte len;
+  byte control;
+  byte item;
+
+  while (i < in_len) {
+    control = in[i++];
+    for (item = 0; item < 8 && i < in_len; item++) {
+      if (control & (1 << item)) {
+        if (n == max_len) return n;
+        out[n++] = in[i++];
+      }
+      else {
+        if (i + 1 >= in_len) return n;
+        dist = (((uint16_t)in[i] << 4) | (in[i + 1] >> 4)) + 1;
+        len = (in[i + 1] & 0x0f) + LZSS_MIN_MATCH;
+        i += 2;
+        if (dist > n) return n;
+        while (len-- && n < max_len) {
+          out[n] = out[n - dist];
+          n++;
+        }
+      }
+    }
+  }
+  return n;
+}
@@ -0,0 +1,88 @@
+/*
+sqrl_batch.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_BATCH_H
+#define __SQRL_BATCH_H
+
+#include "Arduino.h"
+#include "sqrl_http.h"
+#include "sqrl_ip.h"
+
+// size of the arena for the records (max. 4096 - the LZSS window)
+#ifndef BATCH_ARENA_LEN
+#define BATCH_ARENA_LEN     256
+#endif
+
+// flush thresholds - see ShouldFlush()
+#define BATCH_FULL_LEN      (BATCH_ARENA_LEN * 3 / 4) // flush when this num. of bytes is used
+#define BATCH_MAX_AGE       300000                    // flush when the oldest record is older (msec.)
+#define BATCH_GOOD_RSSI     15                        // flush earlier with this average rssi or better..
+#define BATCH_GOOD_LEN      (BATCH_ARENA_LEN / 4)     // ..when at least this num. of bytes is used
+
+// format of the body (first byte)
+enum batch_format_enum {
+  BATCH_RAW = 0,    // records follow as they are
+  BATCH_LZSS        // records are compressed by the LZSS
+};
+
+/**********************************************************
+  Batch of telemetry records
+
+  Records are accumulated in a fixed arena as
+  <len><len bytes of record> and the whole batch is sent by
+  one request. Optionally the batch is compressed by LZSS
+  (12 bit distance, 4 bit length, control byte per 8 items)
+  on the fly while it is read by the upload, so there is no
+  second buffer for the compressed data.
+
+  Body: <format> <records or LZSS stream>
+**********************************************************/
+class TelemetryBatch {
+  private:
+    byte arena[BATCH_ARENA_LEN];
+    uint16_t used;              // num. of bytes used in the arena
+    uint16_t records;           // num. of records in the arena
+    unsigned long first_at;     // millis() of the first record
+    byte format;
+
+    // state of the reading of the body
+    uint16_t rd_pos;            // position in the arena
+    byte rd_group[17];          // LZSS group: control byte + 8 items of max. 2 bytes
+    byte rd_group_len;
+    byte rd_group_pos;
+    byte rd_header;             // format byte was not read yet
+    byte rd_frame;              // num. of bytes of the frame length not read yet
+    uint16_t rd_frame_len;      // frame length - see Flush(IpSockets&, byte)
+
+    void EncodeGroup(void);
+
+  public:
+    TelemetryBatch(void);
+
+    byte Add(const byte *record, byte len);
+    byte Add(const char *record);
+    void Clear(void);
+    byte ShouldFlush(byte rssi_avg);
+
+    inline void SetFormat(byte fmt) {format = fmt;};
+    inline uint16_t GetUsed(void) {return used;};
+    inline uint16_t GetRecords(void) {return records;};
+
+    // reading of the body
+    void Rewind(void);
+    uint16_t Read(byte *buf, uint16_t max_len);
+    long BodyLength(void);
+    static uint16_t Source(void *context, char *buf, uint16_t max_len);
+    static uint16_t FrameSource(void *context, char *buf, uint16_t max_len);
+
+    // upload
+    byte Flush(HttpSession &http, const char *url);
+    byte Flush(IpSockets &sockets, byte id);
+};
+
+uint16_t LzssDecode(const byte *in, uint16_t in_len, byte *out, uint16_t max_len);
+
+#endif
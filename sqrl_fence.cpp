@@ -0,0 +1,272 @@
+/*
+sqrl_fence.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_fence.h"
+
+extern "C" {
+  #include <math.h>
+}
+
+// metres per 1e-6 deg. of latitude (mean Earth radius)
+#define FENCE_M_PER_E6      (EARTH_MEAN_RADIUS * DEG_TO_RAD * 0.000001)
+// initial cell size of the grid in 1e-6 deg. (approx. 110 m)
+#define FENCE_CELL_MIN      1000L
+
+Geofences::Geofences(void) {
+  fences = NULL;
+  fence_count = 0;
+  cols = 0;
+  rows = 0;
+  inside_count = 0;
+  dwell_time = FENCE_DWELL_TIME;
+  handler = NULL;
+  handler_ctx = NULL;
+}
+
+/**********************************************************
+Method computes the bounding box of the fence in 1e-6 deg.
+- fences must not cross the 180 deg. meridian
+**********************************************************/
+void Geofences::Bounds(const fence_t &f, long &lat_min, long &lat_max, long &lon_min, long &lon_max)
+{
+  byte i;
+
+  if (f.type == FENCE_CIRCLE) {
+    double c = cos(f.points[0].lat * (DEG_TO_RAD * 0.000001));
+    long dlat = (long)(f.radius_m / FENCE_M_PER_E6) + 1;
+    long dlon;
+
+    if (c < 0.01) c = 0.01;
+    dlon = (long)(dlat / c) + 1;
+    lat_min = f.points[0].lat - dlat;
+    lat_max = f.points[0].lat + dlat;
+    lon_min = f.points[0].lon - dlon;
+    lon_max = f.points[0].lon + dlon;
+    return;
+  }
+
+  lat_min = lat_max = f.points[0].lat;
+  lon_min = lon_max = f.points[0].lon;
+  for (i = 1; i < f.count; i++) {
+    if (f.points[i].lat < lat_min) lat_min = f.points[i].lat;
+    if (f.points[i].lat > lat_max) lat_max = f.points[i].lat;
+    if (f.points[i].lon < lon_min) lon_min = f.points[i].lon;
+    if (f.points[i].lon > lon_max) lon_max = f.points[i].lon;
+  }
+}
+
+/**********************************************************
+Method builds the grid index of the fences
+- the cell size starts at approx. 110 m and it is doubled
+  until the cells fit to max_cells and the fence lists fit
+  to max_items
+- fences the position is inside are forgotten
+
+fence_list: fences, kept by the caller while used
+count:      num. of fences
+start:      array of max_cells+1 items for the cell offsets
+max_cells:  max. num. of cells of the grid
+items:      array for the fence lists of the cells
+max_items:  num. of items of the array, at least count
+
+return: 0 - fences do not fit to the arrays
+        1 - index was built
+**********************************************************/
+byte Geofences::Build(const fence_t *fence_list, uint16_t count,
+                      uint16_t *start, uint16_t max_cells, uint16_t *items, uint16_t max_items)
+{
+  long lat_min, lat_max, lon_min, lon_max;
+  long f_lat_min, f_lat_max, f_lon_min, f_lon_max;
+  long size;
+  unsigned long n_cols, n_rows, total;
+  unsigned long i;              // up to max_cells, which can be 0xffff
+  uint16_t f, c, r;
+
+  fences = fence_list;
+  fence_count = count;
+  cell_start = start;
+  cell_items = items;
+  cols = 0;
+  rows = 0;
+  inside_count = 0;
+
+  if (count == 0 || max_cells == 0) return (0);
+
+  Bounds(fences[0], lat_min, lat_max, lon_min, lon_max);
+  for (f = 1; f < count; f++) {
+    Bounds(fences[f], f_lat_min, f_lat_max, f_lon_min, f_lon_max);
+    if (f_lat_min < lat_min) lat_min = f_lat_min;
+    if (f_lat_max > lat_max) lat_max = f_lat_max;
+    if (f_lon_min < lon_min) lon_min = f_lon_min;
+    if (f_lon_max > lon_max) lon_max = f_lon_max;
+  }
+  grid_lat = lat_min;
+  grid_lon = lon_min;
+
+  for (size = FENCE_CELL_MIN; ; size *= 2) {
+    n_cols = (lon_max - lon_min) / size + 1;
+    n_rows = (lat_max - lat_min) / size + 1;
+    if (n_cols * n_rows > max_cells) continue;
+
+    // num. of the items of all the cells
+    total = 0;
+    for (f = 0; f < count; f++) {
+      Bounds(fences[f], f_lat_min, f_lat_max, f_lon_min, f_lon_max);
+      total += ((f_lon_max - lon_min) / size - (f_lon_min - lon_min) / size + 1)
+               * ((f_lat_max - lat_min) / size - (f_lat_min - lat_min) / size + 1);
+    }
+    if (total <= max_items) break;
+    if (n_cols == 1 && n_rows == 1) return (0);
+  }
+  cell_size = size;
+  cols = n_cols;
+  rows = n_rows;
+
+  // count the items of the cells to start[cell+1]
+  for (i = 0; i <= cols * rows; i++) start[i] = 0;
+  for (f = 0; f < count; f++) {
+    Bounds(fences[f], f_lat_min, f_lat_max, f_lon_min, f_lon_max);
+    for (r = (f_lat_min - lat_min) / size; r <= (f_lat_max - lat_min) / size; r++) {
+      for (c = (f_lon_min - lon_min) / size; c <= (f_lon_max - lon_min) / size; c++) {
+        start[r * cols + c + 1]++;
+      }
+    }
+  }
+  // start[cell] is the first item of the cell
+  for (i = 0; i < cols * rows; i++) start[i + 1] += start[i];
+
+  // fill - start[cell] is moved to the end of the cell..
+  for (f = 0; f < count; f++) {
+    Bounds(fences[f], f_lat_min, f_lat_max, f_lon_min, f_lon_max);
+    for (r = (f_lat_min - lat_min) / size; r <= (f_lat_max - lat_min) / size; r++) {
+      for (c = (f_lon_min - lon_min) / size; c <= (f_lon_max - lon_min) / size; c++) {
+        items[start[r * cols + c]++] = f;
+      }
+    }
+  }
+  // ..which is the first item of the next cell
+  for (i = cols * rows; i > 0; i--) start[i] = start[i - 1];
+  start[0] = 0;
+
+  return (1);
+}
+
+/**********************************************************
+Method tests whether the position is inside the fence
+- circle: local flat projection (error far below the GPS
+  error for radius up to tens of km)
+- polygon: even-odd rule, edges on the boundary may count
+  either way
+**********************************************************/
+byte Geofences::Contains(uint16_t fence, const position_e6_t &pos)
+{
+  const fence_t &f = fences[fence];
+  byte inside = 0;
+  byte i, j;
+
+  if (f.type == FENCE_CIRCLE) {
+    double dy = (pos.lat - f.points[0].lat) * FENCE_M_PER_E6;
+    double dx = (pos.lon - f.points[0].lon) * FENCE_M_PER_E6
+                * cos(f.points[0].lat * (DEG_TO_RAD * 0.000001));
+
+    return (dx * dx + dy * dy <= (double)f.radius_m * f.radius_m);
+  }
+
+  // coordinates relative to the position keep the float
+  // precision for fences of any size
+  for (i = 0, j = f.count - 1; i < f.count; j = i++) {
+    long yi = f.points[i].lat - pos.lat;
+    long yj = f.points[j].lat - pos.lat;
+
+    if ((yi > 0) != (yj > 0)) {
+      double xi = f.points[i].lon - pos.lon;
+      double xj = f.points[j].lon - pos.lon;
+
+      // edge crosses the parallel of the position east of it
+      if ((xj - xi) * (double)(-yi) / (double)(yj - yi) + xi > 0) inside = !inside;
+    }
+  }
+  return (inside);
+}
+
+/**********************************************************
+Method reports one event to the handler
+**********************************************************/
+byte Geofences::Event(uint16_t fence, byte event)
+{
+  if (handler != NULL) handler(handler_ctx, fence, event);
+  return (1);
+}
+
+/**********************************************************
+Method processes a new position, e.g. from CheckLocation()
+- fences the position was inside are tested for FENCE_EXIT
+  and FENCE_DWELL
+- fences of the cell of the position are tested for
+  FENCE_ENTER
+- if the position is inside more than FENCE_INSIDE_MAX
+  fences the further ones are not reported
+
+return: num. of events reported to the handler
+**********************************************************/
+byte Geofences::Update(const position_e6_t &pos)
+{
+  uint16_t now = millis() / 1000;
+  byte events = 0;
+  byte k;
+  uint16_t i, end;
+  long c, r;
+
+  if (cols == 0) return (0);
+
+  k = 0;
+  while (k < inside_count) {
+    if (!Contains(inside[k], pos)) {
+      events += Event(inside[k], FENCE_EXIT);
+      inside_count--;
+      inside[k] = inside[inside_count];
+      inside_since[k] = inside_since[inside_count];
+      inside_dwell[k] = inside_dwell[inside_count];
+      continue;
+    }
+    if (!inside_dwell[k] && (uint16_t)(now - inside_since[k]) >= dwell_time) {
+      events += Event(inside[k], FENCE_DWELL);
+      inside_dwell[k] = 1;
+    }
+    k++;
+  }
+
+  c = (pos.lon - grid_lon) / cell_size;
+  r = (pos.lat - grid_lat) / cell_size;
+  if (pos.lon < grid_lon || pos.lat < grid_lat || c >= cols || r >= rows) return (events);
+
+  end = cell_start[r * cols + c + 1];
+  for (i = cell_start[r * cols + c]; i < end; i++) {
+    if (inside_count >= FENCE_INSIDE_MAX) break;
+    if (IsInside(cell_items[i])) continue;
+    if (!Contains(cell_items[i], pos)) continue;
+
+    inside[inside_count] = cell_items[i];
+    inside_since[inside_count] = now;
+    inside_dwell[inside_count] = 0;
+    inside_count++;
+    events += Event(cell_items[i], FENCE_ENTER);
+  }
+  return (events);
+}
+
+/**********************************************************
+Method returns 1 if the last position was inside the fence
+**********************************************************/
+byte Geofences::IsInside(uint16_t fence)
+{
+  byte k;
+
+  for (k = 0; k < inside_count; k++) {
+    if (inside[k] == fence) return (1);
+  }
+  return (0);
+}
@@ -0,0 +1,99 @@
+/*
+sqrl_fence.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_FENCE_H
+#define __SQRL_FENCE_H
+
+#include "Arduino.h"
+#include "sqrl_gps.h"
+#include "sqrl_geo.h"
+
+// max. num. of fences the position can be inside at once
+#define FENCE_INSIDE_MAX    8
+// default time inside the fence before FENCE_DWELL (sec.)
+#define FENCE_DWELL_TIME    300
+
+enum fence_type_enum {
+  FENCE_CIRCLE = 0,   // points[0] is the centre
+  FENCE_POLYGON       // points[0..count-1] are the vertices
+};
+
+enum fence_event_enum {
+  FENCE_ENTER = 0,
+  FENCE_EXIT,
+  FENCE_DWELL         // position has been inside for the dwell time
+};
+
+// fence definition, the points are owned by the caller
+struct fence_t {
+  const position_e6_t *points;
+  uint16_t radius_m;  // FENCE_CIRCLE only
+  byte count;         // FENCE_POLYGON only, num. of vertices
+  byte type;          // fence_type_enum
+};
+
+// called by Update() for every event
+typedef void (*fence_handler_t)(void *context, uint16_t fence, byte event);
+
+/**********************************************************
+  Geofences with the uniform grid index
+
+  The bounding box of all the fences is divided into cells
+  and every cell lists the fences whose bounding box touches
+  it (compressed rows - the list of cell i is
+  items[start[i]..start[i+1]-1]). A position is tested only
+  against the fences of its cell, so the cost of Update()
+  does not grow with the num. of fences.
+
+  Fences the position is inside are tracked in a short list,
+  so FENCE_EXIT is found without scanning all the fences.
+
+  All the arrays are owned by the caller, so the fences and
+  the index can be sized to the RAM (or kept in a static
+  buffer on the host).
+**********************************************************/
+class Geofences {
+  private:
+    const fence_t *fences;
+    uint16_t fence_count;
+
+    // grid
+    uint16_t *cell_start;       // cols*rows+1 items
+    uint16_t *cell_items;
+    long grid_lat;              // south-west corner in 1e-6 deg.
+    long grid_lon;
+    long cell_size;             // in 1e-6 deg.
+    uint16_t cols;
+    uint16_t rows;
+
+    // fences the position is inside
+    uint16_t inside[FENCE_INSIDE_MAX];
+    uint16_t inside_since[FENCE_INSIDE_MAX];  // sec. (from millis()) when entered
+    byte inside_dwell[FENCE_INSIDE_MAX];      // FENCE_DWELL was reported
+    byte inside_count;
+    uint16_t dwell_time;
+
+    fence_handler_t handler;
+    void *handler_ctx;
+
+    void Bounds(const fence_t &f, long &lat_min, long &lat_max, long &lon_min, long &lon_max);
+    byte Event(uint16_t fence, byte event);
+
+  public:
+    Geofences(void);
+
+    byte Build(const fence_t *fence_list, uint16_t count,
+               uint16_t *start, uint16_t max_cells, uint16_t *items, uint16_t max_items);
+    byte Update(const position_e6_t &pos);
+    byte IsInside(uint16_t fence);
+    byte Contains(uint16_t fence, const position_e6_t &pos);
+
+    inline void SetHandler(fence_handler_t h, void *context) {handler = h; handler_ctx = context;};
+    inline void SetDwellTime(uint16_t sec) {dwell_time = sec;};
+    inline byte GetInsideCount(void) {return inside_count;};
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+sqrl_geo.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_geo.h"
+
+extern "C" {
+  #include <math.h>
+}
+
+/**********************************************************
+Function fills one point of the structure-of-arrays buffer
+
+points: buffer of points, the arrays must have at least i+1
+        items
+i:      index of the point
+pos:    position in degrees or microdegrees
+**********************************************************/
+void GeoSetPoint(geo_points_t &points, uint16_t i, const position_t &pos)
+{
+  points.lat[i] = pos.lat * DEG_TO_RAD;
+  points.lon[i] = pos.lon * DEG_TO_RAD;
+  points.cos_lat[i] = cos(points.lat[i]);
+}
+
+void GeoSetPoint(geo_points_t &points, uint16_t i, const position_e6_t &pos)
+{
+  points.lat[i] = pos.lat * (DEG_TO_RAD * 0.000001);
+  points.lon[i] = pos.lon * (DEG_TO_RAD * 0.000001);
+  points.cos_lat[i] = cos(points.lat[i]);
+}
+
+/**
+ * http://en.wikipedia.org/wiki/Law_of_haversines
+ * hav(x) = sin(x/2)^2, the square is a multiplication - pow()
+ * is much slower on AVR and prevents vectorization
+ */
+double GeoRadiansBetween(const position_t &from, const position_t &to)
+{
+  double lat_sin = sin((from.lat - to.lat) * (DEG_TO_RAD * 0.5));
+  double lon_sin = sin((from.lon - to.lon) * (DEG_TO_RAD * 0.5));
+  double a = lat_sin * lat_sin
+             + cos(from.lat * DEG_TO_RAD) * cos(to.lat * DEG_TO_RAD) * lon_sin * lon_sin;
+
+  if (a > 1.0) a = 1.0;
+  return 2.0 * asin(sqrt(a));
+}
+
+/**********************************************************
+Function computes distances (haversine) from one point to
+all the sites
+
+points: buffer with the point the distances are measured from
+from:   index of the point in the points
+sites:  buffer of sites
+dist:   filled by sites.count distances in metres
+**********************************************************/
+void GeoDistances(const geo_points_t &points, uint16_t from, const geo_points_t &sites, double *dist)
+{
+  const double lat0 = points.lat[from];
+  const double lon0 = points.lon[from];
+  const double cos0 = points.cos_lat[from];
+  const double *lat = sites.lat;
+  const double *lon = sites.lon;
+  const double *cos_lat = sites.cos_lat;
+  uint16_t i;
+
+  for (i = 0; i < sites.count; i++) {
+    double lat_sin = sin((lat[i] - lat0) * 0.5);
+    double lon_sin = sin((lon[i] - lon0) * 0.5);
+    double a = lat_sin * lat_sin + cos0 * cos_lat[i] * lon_sin * lon_sin;
+
+    if (a > 1.0) a = 1.0;
+    dist[i] = (2.0 * EARTH_MEAN_RADIUS) * asin(sqrt(a));
+  }
+}
+
+/**********************************************************
+Function computes distances from one point to all the sites
+like GeoDistances() but faster
+- sites within GEO_FAST_MAX_RAD in both latitude and
+  longitude use the equirectangular approximation (one
+  sqrt, no trigonometric function) with the relative error
+  below GEO_FAST_REL_ERR
+- other sites are computed by haversine in the second pass,
+  so the first loop has no branches
+**********************************************************/
+void GeoDistancesFast(const geo_points_t &points, uint16_t from, const geo_points_t &sites, double *dist)
+{
+  const double lat0 = points.lat[from];
+  const double lon0 = points.lon[from];
+  const double cos0 = points.cos_lat[from];
+  const double *lat = sites.lat;
+  const double *lon = sites.lon;
+  const double *cos_lat = sites.cos_lat;
+  uint16_t i;
+
+  for (i = 0; i < sites.count; i++) {
+    double y = lat[i] - lat0;
+    // mean of cosines is cos() of the mean latitude within
+    // the GEO_FAST_MAX_RAD
+    double x = (lon[i] - lon0) * 0.5 * (cos0 + cos_lat[i]);
+
+    dist[i] = EARTH_MEAN_RADIUS * sqrt(x * x + y * y);
+  }
+
+  for (i = 0; i < sites.count; i++) {
+    if (fabs(lat[i] - lat0) > GEO_FAST_MAX_RAD || fabs(lon[i] - lon0) > GEO_FAST_MAX_RAD) {
+      double lat_sin = sin((lat[i] - lat0) * 0.5);
+      double lon_sin = sin((lon[i] - lon0) * 0.5);
+      double a = lat_sin * lat_sin + cos0 * cos_lat[i] * lon_sin * lon_sin;
+
+      if (a > 1.0) a = 1.0;
+      dist[i] = (2.0 * EARTH_MEAN_RADIUS) * asin(sqrt(a));
+    }
+  }
+}
+
+/**********************************************************
+Function finds the site nearest to the point
+- sites are compared by the haversine term which grows with
+  the distance, so asin() and sqrt() are computed only once
+  for the nearest site
+
+points: buffer with the point
+from:   index of the point in the points
+sites:  buffer of sites
+dist:   filled by the distance to the nearest site in metres
+
+return: index of the nearest site, 0xffff - there is no site
+**********************************************************/
+uint16_t GeoNearest(const geo_points_t &points, uint16_t from, const geo_points_t &sites, double &dist)
+{
+  const double lat0 = points.lat[from];
+  const double lon0 = points.lon[from];
+  const double cos0 = points.cos_lat[from];
+  uint16_t nearest = 0xffff;
+  double a_min = 2.0;
+  uint16_t i;
+
+  for (i = 0; i < sites.count; i++) {
+    double lat_sin = sin((sites.lat[i] - lat0) * 0.5);
+    double lon_sin = sin((sites.lon[i] - lon0) * 0.5);
+    double a = lat_sin * lat_sin + cos0 * sites.cos_lat[i] * lon_sin * lon_sin;
+
+    if (a < a_min) {
+      a_min = a;
+      nearest = i;
+    }
+  }
+
+  if (a_min > 1.0) a_min = 1.0;
+  dist = (2.0 * EARTH_MEAN_RADIUS) * asin(sqrt(a_min));
+  return (nearest);
+}
+
+/**********************************************************
+Function finds the nearest site for every point
+
+index: filled by points.count indexes of the nearest sites
+dist:  filled by points.count distances in metres, can be
+       NULL
+**********************************************************/
+void GeoNearestAll(const geo_points_t &points, const geo_points_t &sites, uint16_t *index, double *dist)
+{
+  double d;
+  uint16_t i;
+
+  for (i = 0; i < points.count; i++) {
+    index[i] = GeoNearest(points, i, sites, d);
+    if (dist != NULL) dist[i] = d;
+  }
+}
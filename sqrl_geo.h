@@ -0,0 +1,51 @@
+/*
+sqrl_geo.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_GEO_H
+#define __SQRL_GEO_H
+
+#include "Arduino.h"
+#include "sqrl_gps.h"
+
+#define DEG_TO_RAD 0.017453292519943295769236907684886 // or, pi div 180
+#define EARTH_MEAN_RADIUS 6372797.560856 // metres
+
+// max. difference of latitude and of longitude (radians) for
+// which the equirectangular approximation is used by the
+// GeoDistancesFast() - approx. 32 km on the equator
+#define GEO_FAST_MAX_RAD    0.005
+// max. relative error of the equirectangular approximation
+// within GEO_FAST_MAX_RAD up to latitude 85 deg. (measured 3e-6,
+// on AVR the float precision of double is of the same order)
+#define GEO_FAST_REL_ERR    0.00001
+
+/**********************************************************
+  Points in the structure-of-arrays layout for the batch
+  distance functions
+
+  Coordinates are kept in radians together with the cosine
+  of the latitude, so the kernels do not convert degrees or
+  call cos() per pair and the loops over the arrays can be
+  vectorized by the compiler. The arrays are owned by the
+  caller, GeoSetPoint() fills one point.
+**********************************************************/
+struct geo_points_t {
+  double *lat;        // latitude in radians
+  double *lon;        // longitude in radians
+  double *cos_lat;    // cos(lat)
+  uint16_t count;
+};
+
+void GeoSetPoint(geo_points_t &points, uint16_t i, const position_t &pos);
+void GeoSetPoint(geo_points_t &points, uint16_t i, const position_e6_t &pos);
+
+double GeoRadiansBetween(const position_t &from, const position_t &to);
+void GeoDistances(const geo_points_t &points, uint16_t from, const geo_points_t &sites, double *dist);
+void GeoDistancesFast(const geo_points_t &points, uint16_t from, const geo_points_t &sites, double *dist);
+uint16_t GeoNearest(const geo_points_t &points, uint16_t from, const geo_points_t &sites, double &dist);
+void GeoNearestAll(const geo_points_t &points, const geo_points_t &sites, uint16_t *index, double *dist);
+
+#endif
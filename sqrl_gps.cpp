@@ -0,0 +1,215 @@
+/*
+sqrl_gps.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_gps.h"
+
+/**********************************************************
+Function converts coordinate in the NMEA format 
+[-]dddmm.mmmmmm to microdegrees in one pass - there is no
+float arithmetic so all 6 decimal places of minutes are kept
+
+E.g.
+Lat -4117.015786 --> -41283596
+Lng 17446.508384 --> 174775140
+
+p:        first character of the coordinate
+microdeg: filled by the coordinate in 1e-6 deg.
+
+return: pointer to the first character after the coordinate
+        NULL - there is no coordinate
+**********************************************************/
+const char *GpsParseCoord(const char *p, long &microdeg)
+{
+  byte neg = 0;
+  byte digits = 0;
+  byte rounded = 0;
+  unsigned long whole = 0;    // dddmm
+  unsigned long frac = 0;     // fraction of minutes in 1e-6
+  unsigned long scale = 100000;
+  unsigned long minutes;      // minutes in 1e-6
+
+  if (*p == '-') {
+    neg = 1;
+    p++;
+  }
+  else if (*p == '+') p++;
+
+  while (*p >= '0' && *p <= '9') {
+    whole = whole * 10 + (*p++ - '0');
+    digits++;
+  }
+  if (*p == '.') {
+    p++;
+    while (*p >= '0' && *p <= '9') {
+      if (scale) {
+        frac += (*p - '0') * scale;
+        scale /= 10;
+      }
+      else if (!rounded) {
+        // 7th decimal place is used for rounding only
+        if (*p >= '5') frac++;
+        rounded = 1;
+      }
+      p++;
+      digits++;
+    }
+  }
+  if (digits == 0) return (NULL);
+
+  minutes = (whole % 100) * 1000000UL + frac;
+  microdeg = (long)((whole / 100) * 1000000UL + (minutes + 30) / 60);
+  if (neg) microdeg = -microdeg;
+  return (p);
+}
+
+/**********************************************************
+Function returns pointer to the first character of the next
+comma separated field, NULL - there is no next field
+**********************************************************/
+const char *GpsSkipField(const char *p)
+{
+  while (*p && *p != ',' && *p != 0x0d && *p != 0x0a) p++;
+  if (*p != ',') return (NULL);
+  return (p + 1);
+}
+
+/**********************************************************
+Function converts coordinate in the NMEA format 
+[-]dddmm.mmmmmm to degrees
+
+return: coordinate in degrees, 0 - there is no coordinate
+**********************************************************/
+double GpsCoordToDegrees(const char *p)
+{
+  long microdeg = 0;
+
+  GpsParseCoord(p, microdeg);
+  return GpsMicroToDegrees(microdeg);
+}
+
+/**********************************************************
+Function converts decimal number [-]iii.ffff to integer
+scaled by 10^decimals (further decimal places are cut)
+
+return: pointer to the first character after the number
+        NULL - there is no number
+**********************************************************/
+const char *GpsParseFixed(const char *p, byte decimals, long &value)
+{
+  byte neg = 0;
+  byte digits = 0;
+  byte d = decimals;
+
+  value = 0;
+  if (*p == '-') {
+    neg = 1;
+    p++;
+  }
+  while (*p >= '0' && *p <= '9') {
+    value = value * 10 + (*p++ - '0');
+    digits++;
+  }
+  if (*p == '.') {
+    p++;
+    while (*p >= '0' && *p <= '9') {
+      if (d) {
+        value = value * 10 + (*p - '0');
+        d--;
+      }
+      p++;
+      digits++;
+    }
+  }
+  if (digits == 0) return (NULL);
+  while (d--) value *= 10;
+  if (neg) value = -value;
+  return (p);
+}
+
+/**********************************************************
+Function parses exactly n decimal digits
+
+return: pointer to the first character after the digits
+        NULL - there are less than n digits
+**********************************************************/
+const char *GpsParseDigits(const char *p, byte n, byte &value)
+{
+  value = 0;
+  while (n--) {
+    if (*p < '0' || *p > '9') return (NULL);
+    value = value * 10 + (*p++ - '0');
+  }
+  return (p);
+}
+
+/**********************************************************
+Function parses the whole AT+CGPSINF=0 record in one pass
+
+<mode>,<long>,<lat>,<alt>,<UTC time>,<TTFF>,<num>,<speed>,<course>
+0,17446.647913,-4117.068521,0.082149,20131025231125.000,534,5,0.000000,0.000000
+
+alt    - altitude in metres
+UTC    - yyyymmddhhmmss.sss
+TTFF   - time to first fix in seconds
+num    - num. of satellites in use
+speed  - speed over ground in knots
+course - course over ground in degrees
+
+p:   first character of the record (leading <CR><LF> and 
+     +CGPSINF: prefix are skipped)
+fix: filled by the record, fix type is not changed
+
+return: 0 - record is not complete
+        1 - record was parsed
+**********************************************************/
+byte GpsParseInf(const char *p, gps_fix_t &fix)
+{
+  long value;
+  byte year;
+  byte century;
+
+  while (*p == 0x0d || *p == 0x0a || *p == ' ') p++;
+  if (*p == '+') {
+    while (*p && *p != ':') p++;
+    if (*p == ':') p++;
+    if (*p == ' ') p++;
+  }
+
+  p = GpsSkipField(p);                                          // mode
+  if (p != NULL) p = GpsParseCoord(p, fix.pos.lon);             // longitude
+  if (p != NULL && *p == ',') p = GpsParseCoord(p + 1, fix.pos.lat); // latitude
+  if (p != NULL && *p == ',') p = GpsParseFixed(p + 1, 2, fix.alt_cm); // altitude
+  if (p == NULL || *p != ',') return (0);
+
+  // UTC time yyyymmddhhmmss.sss
+  p++;
+  p = GpsParseDigits(p, 2, century);
+  if (p != NULL) p = GpsParseDigits(p, 2, year);
+  if (p != NULL) p = GpsParseDigits(p, 2, fix.month);
+  if (p != NULL) p = GpsParseDigits(p, 2, fix.day);
+  if (p != NULL) p = GpsParseDigits(p, 2, fix.hour);
+  if (p != NULL) p = GpsParseDigits(p, 2, fix.minute);
+  if (p != NULL) p = GpsParseDigits(p, 2, fix.second);
+  if (p == NULL) return (0);
+  fix.year = year;
+  p = GpsSkipField(p);
+
+  if (p != NULL) p = GpsParseFixed(p, 0, value);                // TTFF
+  if (p == NULL || *p != ',') return (0);
+  fix.ttff = value;
+  p = GpsParseFixed(p + 1, 0, value);                           // num
+  if (p == NULL || *p != ',') return (0);
+  fix.sats = value;
+  p = GpsParseFixed(p + 1, 3, value);                           // speed in 0.001 knots
+  if (p == NULL || *p != ',') return (0);
+  // 1 knot = 51.4444 cm/s => 0.001 knot = 1286/25000 cm/s
+  fix.speed_cms = (value * 1286 + 12500) / 25000;
+  p = GpsParseFixed(p + 1, 2, value);                           // course
+  if (p == NULL) return (0);
+  fix.course_cdeg = value % 36000;
+
+  return (1);
+}
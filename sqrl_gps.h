@@ -0,0 +1,64 @@
+/*
+sqrl_gps.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_GPS_H
+#define __SQRL_GPS_H
+
+#include "Arduino.h"
+
+// position in degrees, north and east are positive
+struct position_t {
+  double lat;
+  double lon;
+};
+
+// position in microdegrees (1e-6 deg.), north and east are positive
+struct position_e6_t {
+  long lat;
+  long lon;
+};
+
+enum gps_fix_enum {
+  GPS_FIX_UNKNOWN = 0,  // Location Unknown - GPS is off or not running
+  GPS_FIX_NONE,         // Location Not Fix
+  GPS_FIX_2D,
+  GPS_FIX_3D
+};
+
+// AT+CGPSRST=<mode>
+enum gps_reset_enum {
+  GPS_RST_COLD = 0,
+  GPS_RST_HOT,          // autonomy mode
+  GPS_RST_WARM
+};
+
+// complete fix from one AT+CGPSINF=0 record, compact integer fields
+struct gps_fix_t {
+  position_e6_t pos;
+  long alt_cm;          // altitude in cm
+  uint16_t speed_cms;   // speed over ground in cm/s
+  uint16_t course_cdeg; // course over ground in 0.01 deg <0..35999>
+  byte year;            // UTC date and time, year since 2000
+  byte month;
+  byte day;
+  byte hour;
+  byte minute;
+  byte second;
+  uint16_t ttff;        // time to first fix in sec.
+  byte sats;            // num. of satellites in use
+  byte fix;             // gps_fix_enum
+};
+
+const char *GpsParseCoord(const char *p, long &microdeg);
+const char *GpsSkipField(const char *p);
+double GpsCoordToDegrees(const char *p);
+const char *GpsParseDigits(const char *p, byte n, byte &value);
+const char *GpsParseFixed(const char *p, byte decimals, long &value);
+byte GpsParseInf(const char *p, gps_fix_t &fix);
+
+inline double GpsMicroToDegrees(long microdeg) {return microdeg * 0.000001;};
+
+#endif
@@ -0,0 +1,650 @@
+/*
+sqrl_http.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_http.h"
+#include <avr/pgmspace.h>
+
+extern "C" {
+  #include <string.h>
+  #include <stdlib.h>
+}
+
+/*
+ Work around a bug with PROGMEM and PSTR where the compiler always
+ generates warnings.
+ */
+#undef PROGMEM
+#define PROGMEM __attribute__(( section(".progmem.data") ))
+#undef PSTR
+#define PSTR(s) (__extension__({static prog_char __c[] PROGMEM = (s); &__c[0];}))
+
+SQRL_STATIC_ASSERT(HTTP_READ_OVERHEAD < AT_COMM_BUF_MIN, http_read_fits_comm_buf);
+
+HttpSession::HttpSession(AtComms &comms) : at(comms) {
+  bearer_state = BEARER_UNKNOWN;
+  http_ready = 0;
+  last_used = 0;
+  idle_tmout = HTTP_IDLE_TMOUT;
+  read_chunk = at.comm_buf_size - HTTP_READ_OVERHEAD;
+  content_type = NULL;
+  last_status = 0;
+  retry_attempts = HTTP_RETRY_ATTEMPTS;
+  backoff_base = HTTP_BACKOFF_BASE;
+  backoff_max = HTTP_BACKOFF_MAX;
+  fail_count = 0;
+  backoff_from = 0;
+  backoff_len = 0;
+  at.AddUrcHandler(UrcHandler, this);
+}
+
+/**********************************************************
+URC handler - bearer deactivated by the network
++SAPBR 1: DEACT
+
+the response +HTTPREAD: <len> is consumed together with its
+<len> bytes of the body, so the body is never taken for URCs
+**********************************************************/
+byte HttpSession::UrcHandler(void *context, byte token, const char *line, byte len)
+{
+  HttpSession *session = (HttpSession *)context;
+  unsigned int used;
+
+  if (token == AT_TOK_HTTPREAD && len > 11) {
+    used = len + atoi(line + 10);
+    return (used > 0xff ? 0xff : used);
+  }
+  if (token == AT_TOK_SAPBR && len >= 15 && strncmp_P(line + 6, PSTR(" 1: DEACT"), 9) == 0) {
+    session->bearer_state = BEARER_CLOSED;
+    return (len);
+  }
+  return (0);
+}
+
+/**********************************************************
+Method makes sure the bearer is open
+- bearer is queried only if its state is not known
+
+comm line must be already reserved by the caller
+
+return: 0 - bearer is not open
+        1 - bearer is open
+**********************************************************/
+byte HttpSession::EnsureBearer(void)
+{
+  char *p_char;
+
+  if (bearer_state == BEARER_OPEN) return 1;
+
+  if (bearer_state == BEARER_UNKNOWN) {
+    //+SAPBR: 1,3,"0.0.0.0" --> closed
+    //+SAPBR: 1,1,"100.70.120.92" --> open
+    at.SendATCmdWaitResp(ATC_SAPBR_QUERY); // query bearer
+    p_char = at.FindToken(AT_TOK_SAPBR);
+    if (p_char != NULL && strncmp_P(p_char + 6, PSTR(": 1,1"), 5) == 0) {
+      bearer_state = BEARER_OPEN;
+      return 1;
+    }
+  }
+
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_SAPBR_OPEN)) { // open bearer
+    bearer_state = BEARER_OPEN;
+    return 1;
+  }
+
+  // "ERROR" is also returned for already open bearer => query it next time
+  bearer_state = BEARER_UNKNOWN;
+  return 0;
+}
+
+/**********************************************************
+Method makes sure the HTTP service is initialized
+
+comm line must be already reserved by the caller
+
+return: 0 - HTTP service is not ready
+        1 - HTTP service is ready
+**********************************************************/
+byte HttpSession::EnsureHttp(void)
+{
+  if (http_ready) return 1;
+
+  if (AT_RESP_OK != at.SendATCmdWaitResp(ATC_HTTPINIT)) {
+    // service could be left initialized e.g. after reset of the Arduino
+    at.SendATCmdWaitResp(ATC_HTTPTERM);
+    if (AT_RESP_OK != at.SendATCmdWaitResp(ATC_HTTPINIT)) return 0;
+  }
+  if (AT_RESP_OK != at.SendATCmdWaitResp(ATC_HTTPPARA_CID)) {
+    Term();
+    return 0;
+  }
+
+  content_type = NULL;
+  http_ready = 1;
+  return 1;
+}
+
+/**********************************************************
+Method terminates the HTTP service
+
+comm line must be already reserved by the caller
+**********************************************************/
+void HttpSession::Term(void)
+{
+  at.SendATCmdWaitResp(ATC_HTTPTERM);
+  http_ready = 0;
+}
+
+/**********************************************************
+Method opens the bearer and initializes the HTTP service
+in advance, so the next request is not delayed
+
+return: HTTP_OK, HTTP_FAIL
+**********************************************************/
+byte HttpSession::Open(void)
+{
+  byte res_code = HTTP_FAIL;
+
+  if (CLS_FREE != at.GetCommLineStatus()) return (res_code);
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  if (EnsureBearer() && EnsureHttp()) {
+    last_used = millis();
+    res_code = HTTP_OK;
+  }
+
+  at.SetCommLineStatus(CLS_FREE);
+  return (res_code);
+}
+
+/**********************************************************
+Method terminates the HTTP service and closes the bearer
+**********************************************************/
+void HttpSession::Close(void)
+{
+  if (CLS_FREE != at.GetCommLineStatus()) return;
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  if (http_ready) Term();
+  at.SendATCmdWaitResp(ATC_SAPBR_CLOSE); // close bearer
+  bearer_state = BEARER_CLOSED;
+
+  at.SetCommLineStatus(CLS_FREE);
+}
+
+/**********************************************************
+Method forgets the session state without communication
+e.g. after the bearer was closed by other commands
+**********************************************************/
+void HttpSession::Invalidate(void)
+{
+  bearer_state = BEARER_UNKNOWN;
+  http_ready = 0;
+}
+
+/**********************************************************
+Method terminates the HTTP service after the idle timeout
+- called regularly from GSM::Poll()
+**********************************************************/
+void HttpSession::Service(void)
+{
+  if (!http_ready || !idle_tmout) return;
+  if ((unsigned long)(millis() - last_used) < idle_tmout) return;
+  if (CLS_FREE != at.GetCommLineStatus()) return;
+
+  at.SetCommLineStatus(CLS_ATCMD);
+  Term();
+  at.SetCommLineStatus(CLS_FREE);
+}
+
+/**********************************************************
+Method sets num. of body bytes read by one AT+HTTPREAD
+len: 1..comm buffer length - HTTP_READ_OVERHEAD
+**********************************************************/
+void HttpSession::SetReadChunk(uint16_t len)
+{
+  if (len == 0) len = 1;
+  if (len > at.comm_buf_size - HTTP_READ_OVERHEAD) len = at.comm_buf_size - HTTP_READ_OVERHEAD;
+  read_chunk = len;
+}
+
+/**********************************************************
+Method parses the result of the AT+HTTPACTION
++HTTPACTION:<method>,<status>,<length>
+
+length: filled by the data length
+
+return: HTTP status code, 0 - result not found
+**********************************************************/
+int HttpSession::ParseActionStatus(long &length)
+{
+  char *p_char;
+  int status = 0;
+
+  length = 0;
+  p_char = at.FindToken(AT_TOK_HTTPACTION);
+  if (p_char == NULL) return 0;
+
+  p_char = strchr(p_char, ',');
+  if (p_char != NULL) {
+    status = atoi(p_char + 1);
+    p_char = strchr(p_char + 1, ',');
+    if (p_char != NULL) length = atol(p_char + 1);
+  }
+  return status;
+}
+
+/**********************************************************
+Method reads the response body by chunks
+AT+HTTPREAD=<offset>,<n> and passes every chunk to the sink
+
+response:
+<CR><LF>+HTTPREAD:<n><CR><LF><n bytes of data><CR><LF>OK<CR><LF>
+
+the body can contain any bytes so the data is taken by the
+length from the +HTTPREAD header, not by the <CR><LF>
+
+comm line must be already reserved by the caller
+
+return: 0 - reading failed
+        1 - whole body was read
+**********************************************************/
+byte HttpSession::ReadBody(long length, http_sink_t sink, void *context)
+{
+  long offset = 0;
+  uint16_t chunk;
+  uint16_t n;
+  char *p_start;
+  char *p_data;
+
+  if (sink != NULL) sink(context, NULL, 0);
+
+  while (offset < length) {
+    chunk = read_chunk;
+    if (length - offset < chunk) chunk = length - offset;
+
+    at.Port().print(F("AT+HTTPREAD="));
+    at.Port().print(offset);
+    at.Port().print(',');
+    at.Port().println(chunk);
+
+    at.UseTiming(ATT_HTTPREAD);
+    if (RX_FINISHED != at.WaitResp(1500, 500)) return 0;
+
+    p_start = at.FindToken(AT_TOK_HTTPREAD);
+    if (p_start == NULL) return 0;
+    n = atoi(p_start + 10);
+    p_data = strchr(p_start, 0x0a);
+    if (p_data == NULL) return 0;
+    p_data++;
+    if (n == 0 || n > chunk
+        || p_data + n > (char *)(at.comm_buf) + at.comm_buf_len) return 0;
+
+    if (sink != NULL) sink(context, p_data, n);
+    offset += n;
+  }
+  return 1;
+}
+
+/**********************************************************
+Method uploads the request body
+AT+HTTPDATA=<size>,<time> - module answers DOWNLOAD and waits
+for <size> bytes, then answers OK
+
+the body is taken from the source by parts which are placed
+into the comm buffer (it is not used during the upload)
+
+comm line must be already reserved by the caller
+
+return: 0 - upload failed
+        1 - whole body was uploaded
+**********************************************************/
+byte HttpSession::WriteBody(long length, http_source_t source, void *context)
+{
+  long offset = 0;
+  long tmout;
+  uint16_t n;
+
+  tmout = HTTP_DATA_TMOUT + length;
+  if (tmout > 120000) tmout = 120000;
+
+  at.Port().print(F("AT+HTTPDATA="));
+  at.Port().print(length);
+  at.Port().print(',');
+  at.Port().println(tmout);
+  if (RX_FINISHED_STR_RECV != at.WaitResp(1500, 100, F("DOWNLOAD"))) return 0;
+
+  while (offset < length) {
+    n = at.comm_buf_size;
+    if (length - offset < n) n = length - offset;
+    n = source(context, (char *)(at.comm_buf), n);
+    if (n == 0) break;
+    at.Port().write(at.comm_buf, n);
+    offset += n;
+  }
+
+  if (offset < length) {
+    // source has less data than announced => finish the upload
+    // so the module does not take next commands as data
+    // and do not send the request
+    while (offset++ < length) at.Port().write((uint8_t)0);
+    at.WaitResp(5000, 100, F("OK"));
+    return 0;
+  }
+  return (RX_FINISHED_STR_RECV == at.WaitResp(5000, 100, F("OK")));
+}
+
+/**********************************************************
+Method sets the retry policy
+
+attempts: num. of attempts of one request (1 - no retry)
+base:     back-off after the first failure in msec.
+max:      max. back-off in msec.
+
+after n failures in a row the back-off is base * 2^(n-1) 
+(max. max) randomly shortened up to one half, so units which 
+failed together do not retry together
+**********************************************************/
+void HttpSession::SetRetryPolicy(byte attempts, unsigned long base, unsigned long max)
+{
+  retry_attempts = attempts ? attempts : 1;
+  backoff_base = base;
+  backoff_max = max;
+}
+
+/**********************************************************
+Method returns the rest of the back-off in msec.
+- requests are refused with HTTP_ERR_BACKOFF until it is 0
+**********************************************************/
+unsigned long HttpSession::GetBackoff(void)
+{
+  unsigned long elapsed;
+
+  if (!backoff_len) return 0;
+  elapsed = (unsigned long)(millis() - backoff_from);
+  if (elapsed >= backoff_len) {
+    backoff_len = 0;
+    return 0;
+  }
+  return (backoff_len - elapsed);
+}
+
+/**********************************************************
+Method computes the back-off after the next failure
+**********************************************************/
+unsigned long HttpSession::NextBackoff(void)
+{
+  unsigned long len = backoff_base;
+  byte i;
+
+  if (fail_count < 255) fail_count++;
+  for (i = 1; i < fail_count && len < backoff_max; i++) len <<= 1;
+  if (len > backoff_max) len = backoff_max;
+
+  // jitter - random part of one half
+  return (len - random(len / 2 + 1));
+}
+
+/**********************************************************
+Method performs one attempt of the HTTP request
+
+method:       HTTP_METHOD_GET, HTTP_METHOD_POST, HTTP_METHOD_HEAD
+url:          URL string
+type:         content type of the body (can be NULL - not changed)
+body_len:     num. of bytes of the body, 0 - no body
+source:       provides the body
+sink:         called for every received part of the response body
+              (can be NULL - the body is not read then)
+
+return: HTTP_OK, HTTP_FAIL, HTTP_ERR_BEARER, HTTP_ERR_NETWORK,
+        HTTP_ERR_STATUS, HTTP_ERR_TIMEOUT
+**********************************************************/
+byte HttpSession::RequestOnce(byte method, const char *url,
+                              const __FlashStringHelper *type, long body_len, http_source_t source, void *src_context,
+                              http_sink_t sink, void *sink_context)
+{
+  byte res_code = HTTP_ERR_TIMEOUT;
+  byte session_err = 1;
+  byte action = 0;
+  long length;
+
+  last_status = 0;
+  if (!EnsureBearer()) return (HTTP_ERR_BEARER);
+  if (!EnsureHttp()) return (HTTP_FAIL);
+
+  at.Port().print(F("AT+HTTPPARA=\"URL\",\""));
+  at.Port().print(url);
+  at.Port().println(F("\""));
+  at.WaitResp(900, 500, F("OK"));
+
+  if (type != NULL && type != content_type) {
+    // content type is kept by the HTTP service => send it only when changed
+    at.Port().print(F("AT+HTTPPARA=\"CONTENT\",\""));
+    at.Port().print(type);
+    at.Port().println(F("\""));
+    if (RX_FINISHED_STR_RECV == at.WaitResp(900, 500, F("OK"))) content_type = type;
+  }
+
+  if (body_len == 0 || (source != NULL && WriteBody(body_len, source, src_context))) {
+    // GET or POST (or HEAD)
+    at.Port().print(F("AT+HTTPACTION="));
+    at.Port().println((int)method);
+    if (RX_FINISHED_STR_RECV == at.WaitResp(1500, 500, F("OK"))) {
+      // Wait for +HTTPACTION:<method>,<status>,<length> unless it came with OK
+      action = at.HasToken(AT_TOK_HTTPACTION);
+      if (!action) {
+        at.UseTiming(ATT_HTTPACTION);
+        action = (RX_FINISHED_STR_RECV == at.WaitResp(20000, 500, F("+HTTPACTION:")));
+      }
+    }
+    if (action) {
+      // +HTTPACTION:0,200,5 --> get, ok, 5 bytes of data
+      // +HTTPACTION:0,601,0 --> get, network error, no data
+      last_status = ParseActionStatus(length);
+      session_err = 0;
+
+      if (last_status >= 600) {
+        // 6xx are errors of the module (network, DNS, ...)
+        res_code = HTTP_ERR_NETWORK;
+        session_err = 1;
+      }
+      else if (last_status != 200) {
+        res_code = HTTP_ERR_STATUS;
+      }
+      else if (sink == NULL || ReadBody(length, sink, sink_context)) {
+        res_code = HTTP_OK;
+      }
+      else {
+        res_code = HTTP_ERR_TIMEOUT;
+        session_err = 1;
+      }
+    }
+  }
+
+  if (session_err) {
+    // set up the session again for the next request
+    Term();
+    bearer_state = BEARER_UNKNOWN;
+  }
+  return (res_code);
+}
+
+/**********************************************************
+Method performs HTTP request with the retry policy
+- failed attempt is repeated after the back-off (if it is not
+  longer than HTTP_RETRY_WAIT_MAX) using the same session
+- HTTP_ERR_STATUS is repeated only for 5xx statuses
+- after the last failed attempt the back-off is armed and
+  following requests are refused with HTTP_ERR_BACKOFF until 
+  it elapses, so callers retrying immediately waste no airtime
+
+return: HTTP_OK, HTTP_FAIL, HTTP_ERR_xxx
+**********************************************************/
+byte HttpSession::Request(byte method, const char *url,
+                          const __FlashStringHelper *type, long body_len, http_source_t source, void *src_context,
+                          http_sink_t sink, void *sink_context)
+{
+  byte res_code = HTTP_FAIL;
+  byte attempt;
+  unsigned long wait;
+
+  if (GetBackoff()) return (HTTP_ERR_BACKOFF);
+  if (CLS_FREE != at.GetCommLineStatus()) return (HTTP_ERR_BUSY);
+
+  for (attempt = 1; ; attempt++) {
+    at.SetCommLineStatus(CLS_ATCMD);
+    res_code = RequestOnce(method, url, type, body_len, source, src_context, sink, sink_context);
+    last_used = millis();
+    at.SetCommLineStatus(CLS_FREE);
+
+    if (res_code == HTTP_OK) {
+      ResetBackoff();
+      break;
+    }
+    if (res_code == HTTP_ERR_STATUS && last_status < 500) {
+      // request itself is wrong - repeating does not help
+      break;
+    }
+
+    wait = NextBackoff();
+    if (attempt >= retry_attempts || wait > HTTP_RETRY_WAIT_MAX
+        || (body_len && !source(src_context, NULL, 0))) {
+      backoff_from = millis();
+      backoff_len = wait;
+      break;
+    }
+    delay(wait);
+  }
+
+  return (res_code);
+}
+
+/**********************************************************
+Method performs HTTP request without body and streams 
+the response body to the sink
+
+return: HTTP_OK - status 200 received and body read
+        HTTP_FAIL, HTTP_ERR_xxx - see Request()
+**********************************************************/
+byte HttpSession::Action(byte method, const char *url, http_sink_t sink, void *context)
+{
+  return Request(method, url, NULL, 0, NULL, NULL, sink, context);
+}
+
+/**********************************************************
+Method performs HTTP POST request with body
+- body is uploaded by the AT+HTTPDATA from the source
+- response body is streamed to the sink
+
+url:         URL string
+type:        content type, e.g. F("application/json")
+body_len:    num. of bytes provided by the source
+source:      provides the body by parts
+sink:        called for every received part of the response body
+             (can be NULL - the body is not read then)
+
+return: HTTP_OK - status 200 received and body read
+        HTTP_FAIL, HTTP_ERR_xxx - see Request()
+**********************************************************/
+byte HttpSession::Post(const char *url, const __FlashStringHelper *type,
+                       long body_len, http_source_t source, void *src_context,
+                       http_sink_t sink, void *sink_context)
+{
+  return Request(HTTP_METHOD_POST, url, type, body_len, source, src_context, sink, sink_context);
+}
+
+// destination of the Action() with the result string
+struct http_result_t {
+  char *buf;
+  uint16_t len;
+  uint16_t max_len;
+};
+
+static void HttpResultSink(void *context, const char *data, uint16_t len)
+{
+  http_result_t *res = (http_result_t *)context;
+
+  if (data == NULL) {
+    // start of the body - the request may be repeated
+    res->len = 0;
+    res->buf[0] = 0x00;
+    return;
+  }
+  if (res->len + len > res->max_len) len = res->max_len - res->len;
+  memcpy(res->buf + res->len, data, len);
+  res->len += len;
+  res->buf[res->len] = 0x00;
+}
+
+/**********************************************************
+Method performs HTTP request and copies the response body
+to the result string
+
+result:  filled by the response body finished by 0x00
+max_len: max. length of the body excluding 0x00 termination
+         character - longer body is cut
+         HTTP_RESULT_LEN - comm. buffer length - HTTP_READ_OVERHEAD
+
+return: HTTP_OK - status 200 received and body read
+        HTTP_FAIL, HTTP_ERR_xxx - see Request()
+**********************************************************/
+byte HttpSession::Action(byte method, const char *url, char *result, uint16_t max_len)
+{
+  http_result_t res;
+
+  res.buf = result;
+  res.len = 0;
+  res.max_len = (max_len == HTTP_RESULT_LEN ? at.comm_buf_size - HTTP_READ_OVERHEAD : max_len);
+  result[0] = 0x00;
+
+  return Action(method, url, HttpResultSink, &res);
+}
+
+// source of the Post() with the body string
+struct http_body_t {
+  const char *body;
+  uint16_t pos;
+  uint16_t len;
+};
+
+static uint16_t HttpBodySource(void *context, char *buf, uint16_t max_len)
+{
+  http_body_t *src = (http_body_t *)context;
+
+  if (buf == NULL) {
+    src->pos = 0;
+    return 1;
+  }
+  if (max_len > src->len - src->pos) max_len = src->len - src->pos;
+  memcpy(buf, src->body + src->pos, max_len);
+  src->pos += max_len;
+  return max_len;
+}
+
+/**********************************************************
+Method performs HTTP POST request with the body string and
+copies the response body to the result string
+
+max_len: see Action() with the result string
+
+return: HTTP_OK - status 200 received and body read
+        HTTP_FAIL, HTTP_ERR_xxx - see Request()
+**********************************************************/
+byte HttpSession::Post(const char *url, const __FlashStringHelper *type, const char *body,
+                       char *result, uint16_t max_len)
+{
+  http_body_t src;
+  http_result_t res;
+
+  src.body = body;
+  src.pos = 0;
+  src.len = strlen(body);
+  res.buf = result;
+  res.len = 0;
+  res.max_len = (max_len == HTTP_RESULT_LEN ? at.comm_buf_size - HTTP_READ_OVERHEAD : max_len);
+  result[0] = 0x00;
+
+  return Request(HTTP_METHOD_POST, url, type, src.len, HttpBodySource, &src, HttpResultSink, &res);
+}
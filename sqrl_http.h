@@ -0,0 +1,157 @@
+/*
+sqrl_http.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_HTTP_H
+#define __SQRL_HTTP_H
+
+#include "Arduino.h"
+#include <avr/pgmspace.h>
+#include "sqrl_at.h"
+
+// HTTP service is terminated after this time without a request (msec.)
+#define HTTP_IDLE_TMOUT     60000
+
+// max. num. of body bytes read by one AT+HTTPREAD
+// - <CR><LF>+HTTPREAD:<n><CR><LF> ... <CR><LF>OK<CR><LF> must fit into the comm buffer too
+#define HTTP_READ_OVERHEAD  32
+
+// max. length of the response copied by Action() with the result string,
+// 0 - one AT+HTTPREAD chunk of the comm buffer (comm. buffer length
+// - HTTP_READ_OVERHEAD), the length is known only at runtime
+#define HTTP_RESULT_LEN     0
+
+/**********************************************************
+  Sink of the response body
+
+  context - pointer passed together with the sink
+  data    - part of the body (NOT finished by 0x00)
+            NULL - body starts, data received by a previous
+            attempt of the request should be dropped
+  len     - num. of bytes in data
+**********************************************************/
+typedef void (*http_sink_t)(void *context, const char *data, uint16_t len);
+
+/**********************************************************
+  Source of the request body
+
+  context - pointer passed together with the source
+  buf     - place for the next part of the body
+            NULL - source should start again from the beginning
+            of the body (before the request is repeated)
+  max_len - max. num. of bytes which can be placed into buf
+
+  return: num. of bytes placed into buf, 0 - no more data
+          for buf == NULL: 1 - source was rewound, 0 - it cannot
+          be rewound so the request is not repeated
+**********************************************************/
+typedef uint16_t (*http_source_t)(void *context, char *buf, uint16_t max_len);
+
+// time for the upload of the body by the AT+HTTPDATA (msec.)
+// - HTTP_DATA_TMOUT plus 1 msec. per byte, max. 120000
+#define HTTP_DATA_TMOUT     5000
+
+// retry policy - see SetRetryPolicy()
+#define HTTP_RETRY_ATTEMPTS 3       // attempts of one request
+#define HTTP_BACKOFF_BASE   2000    // back-off after the first failure (msec.)
+#define HTTP_BACKOFF_MAX    300000  // max. back-off (msec.)
+#define HTTP_RETRY_WAIT_MAX 10000   // longer back-off is not waited for inside the request
+
+enum httpget_ret_val_enum {
+  HTTP_OK = 0,
+  HTTP_FAIL,          // other failure of the module (e.g. AT+HTTPINIT)
+  HTTP_ERR_BUSY,      // comm line is not free
+  HTTP_ERR_BEARER,    // bearer cannot be opened
+  HTTP_ERR_NETWORK,   // module reported 6xx status (network error, DNS, ...)
+  HTTP_ERR_STATUS,    // server answered other status than 200 - see GetStatus()
+  HTTP_ERR_TIMEOUT,   // module did not answer or the data transfer failed
+  HTTP_ERR_BACKOFF    // request was not sent - back-off after previous failures
+};
+
+// method numbers of the AT+HTTPACTION command
+enum http_method_enum {
+  HTTP_METHOD_GET = 0,
+  HTTP_METHOD_POST,
+  HTTP_METHOD_HEAD
+};
+
+// state of the GPRS bearer (profile 1) as known by the session
+enum bearer_state_enum {
+  BEARER_UNKNOWN = 0, // not queried yet or queried state is not valid any more
+  BEARER_CLOSED,
+  BEARER_OPEN
+};
+
+/**********************************************************
+  GPRS bearer and HTTP service session
+
+  Bearer is opened once and the HTTP service (AT+HTTPINIT)
+  is kept initialized between requests. Both are set up again
+  only after an error, the +SAPBR DEACT URC or the idle timeout.
+**********************************************************/
+class HttpSession {
+  private:
+    AtComms &at;
+    byte bearer_state;
+    byte http_ready;            // AT+HTTPINIT and CID parameter were sent
+    unsigned long last_used;    // millis() of the last request
+    unsigned long idle_tmout;   // 0 - HTTP service is never terminated
+    uint16_t read_chunk;        // num. of bytes requested by one AT+HTTPREAD
+    const __FlashStringHelper *content_type; // last CONTENT parameter sent
+    int last_status;            // HTTP status of the last +HTTPACTION, 0 - none
+
+    // retry policy
+    byte retry_attempts;
+    unsigned long backoff_base;
+    unsigned long backoff_max;
+    byte fail_count;            // num. of failures in a row
+    unsigned long backoff_from; // millis() of the last failure
+    unsigned long backoff_len;  // 0 - no back-off
+
+    byte EnsureBearer(void);
+    byte EnsureHttp(void);
+    void Term(void);
+    int ParseActionStatus(long &length);
+    byte ReadBody(long length, http_sink_t sink, void *context);
+    byte WriteBody(long length, http_source_t source, void *context);
+    byte RequestOnce(byte method, const char *url,
+                     const __FlashStringHelper *type, long body_len, http_source_t source, void *src_context,
+                     http_sink_t sink, void *sink_context);
+    unsigned long NextBackoff(void);
+    byte Request(byte method, const char *url,
+                 const __FlashStringHelper *type, long body_len, http_source_t source, void *src_context,
+                 http_sink_t sink, void *sink_context);
+
+    static byte UrcHandler(void *context, byte token, const char *line, byte len);
+
+  public:
+    HttpSession(AtComms &comms);
+
+    byte Open(void);
+    void Close(void);
+    void Invalidate(void);
+    void Service(void);
+
+    byte Action(byte method, const char *url, http_sink_t sink, void *context);
+    byte Action(byte method, const char *url, char *result, uint16_t max_len = HTTP_RESULT_LEN);
+    byte Post(const char *url, const __FlashStringHelper *type,
+              long body_len, http_source_t source, void *src_context,
+              http_sink_t sink, void *sink_context);
+    byte Post(const char *url, const __FlashStringHelper *type, const char *body,
+              char *result, uint16_t max_len = HTTP_RESULT_LEN);
+
+    inline byte GetBearerState(void) {return bearer_state;};
+    inline byte IsReady(void) {return http_ready;};
+    inline void SetIdleTimeout(unsigned long tmout) {idle_tmout = tmout;};
+    void SetReadChunk(uint16_t len);
+
+    // retry policy
+    void SetRetryPolicy(byte attempts, unsigned long base, unsigned long max);
+    unsigned long GetBackoff(void);
+    inline void ResetBackoff(void) {fail_count = 0; backoff_len = 0;};
+    inline int GetStatus(void) {return last_status;};
+};
+
+#endif
@@ -0,0 +1,525 @@
+/*
+sqrl_ip.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_ip.h"
+#include <avr/pgmspace.h>
+
+extern "C" {
+  #include <string.h>
+  #include <stdlib.h>
+}
+
+/*
+ Work around a bug with PROGMEM and PSTR where the compiler always
+ generates warnings.
+ */
+#undef PROGMEM
+#define PROGMEM __attribute__(( section(".progmem.data") ))
+#undef PSTR
+#define PSTR(s) (__extension__({static prog_char __c[] PROGMEM = (s); &__c[0];}))
+
+
+/**********************************************************
+Function activates the GPRS context of the TCP/IP stack
+AT+CSTT, AT+CIICR and AT+CIFSR
+
+- the stack must be in the initial state (after AT+CIPSHUT)
+  and the connection mode (AT+CIPMUX, AT+CIPMODE) must be
+  already selected
+- comm line must be already reserved by the caller
+
+apn: access point name, e.g. "internet"
+
+return: 0 - context was not activated
+        1 - context is activated
+**********************************************************/
+byte IpActivate(AtComms &at, const char *apn)
+{
+  at.Port().print(F("AT+CSTT=\""));
+  at.Port().print(apn);
+  at.Port().println(F("\""));
+  if (RX_FINISHED_STR_RECV != at.WaitResp(2000, 50, F("OK"))) return 0;
+  if (AT_RESP_OK != at.SendATCmdWaitResp(ATC_CIICR)) return 0;
+
+  // local IP address must be queried before the first connection
+  // response is only the address (no OK)
+  at.Port().println(F("AT+CIFSR"));
+  if (RX_FINISHED != at.WaitResp(2000, 100) || at.HasToken(AT_TOK_ERROR)) return 0;
+  return 1;
+}
+
+SQRL_STATIC_ASSERT(IP_RXGET_OVERHEAD < AT_COMM_BUF_MIN, ip_rxget_fits_comm_buf);
+
+IpSockets::IpSockets(AtComms &comms) : at(comms) {
+  ip_state = IP_DOWN;
+  send_state = SEND_IDLE;
+  ResetConns();
+  at.AddUrcHandler(UrcHandler, this);
+}
+
+void IpSockets::ResetConns(void)
+{
+  byte i;
+
+  for (i = 0; i < IP_CONN_COUNT; i++) {
+    conns[i].state = CONN_CLOSED;
+    conns[i].rx_pending = 0;
+    conns[i].rx_head = 0;
+    conns[i].rx_count = 0;
+  }
+}
+
+/**********************************************************
+URC handler
+
+<n>, CONNECT OK         - connection was opened
+<n>, CONNECT FAIL       - connection was not opened
+<n>, ALREADY CONNECT    - connection is already open
+<n>, CLOSED             - connection was closed by the remote side
++CIPRXGET: 1,<n>        - data received on the connection
++PDP: DEACT             - GPRS context was deactivated by the network
+
+the response +CIPRXGET: 2,<n>,<len>,... is consumed together with
+its <len> bytes of data, so the data is never taken for URCs
+**********************************************************/
+byte IpSockets::UrcHandler(void *context, byte token, const char *line, byte len)
+{
+  IpSockets *sockets = (IpSockets *)context;
+  const char *p;
+  byte id;
+  unsigned int used;
+
+  switch (token) {
+    case AT_TOK_CIPRXGET:
+      p = line + 10;
+      if (*p == ' ') p++;
+      // only the notification +CIPRXGET: 1,<n>, other modes are responses
+      if (len > 10 && p[0] == '1' && p[1] == ',') {
+        id = atoi(p + 2);
+        if (id < IP_CONN_COUNT) sockets->conns[id].rx_pending = 1;
+        return (len);
+      }
+      // data fetched by AT+CIPRXGET=2 follows the line
+      if (len > 10 && p[0] == '2' && p[1] == ',') {
+        p = strchr(p + 2, ',');                   // <len>
+        if (p == NULL || p >= line + len) return (0);
+        used = len + atoi(p + 1);
+        return (used > 0xff ? 0xff : used);
+      }
+      return (0);
+
+    case AT_TOK_PDP:
+      if (len < 11 || strncmp_P(line + 4, PSTR(": DEACT"), 7) != 0) return (0);
+      sockets->ip_state = IP_DOWN;
+      sockets->ResetConns();
+      return (len);
+
+    case AT_TOK_CONNECT_OK:
+    case AT_TOK_ALREADY_CONNECT:
+    case AT_TOK_CONNECT_FAIL:
+    case AT_TOK_CLOSED:
+    case AT_TOK_CLOSE_OK:
+      return (sockets->ParseConnUrc(token, line, len));
+  }
+  return (0);
+}
+
+byte IpSockets::ParseConnUrc(byte token, const char *line, byte line_len)
+{
+  byte id;
+
+  // <n>, <text> - <text> was already classified
+  if (line_len < 4 || line[0] < '0' || line[0] > '9' || line[1] != ',' || line[2] != ' ') return (0);
+  id = line[0] - '0';
+  if (id >= IP_CONN_COUNT) return (0);
+
+  if (token == AT_TOK_CONNECT_OK || token == AT_TOK_ALREADY_CONNECT) {
+    conns[id].state = CONN_CONNECTED;
+  }
+  else {
+    // data already in the ring can be still read
+    conns[id].state = CONN_CLOSED;
+    conns[id].rx_pending = 0;
+  }
+
+  return (line_len);
+}
+
+/**********************************************************
+Method activates the GPRS context for the sockets
+
+apn: access point name, e.g. "internet"
+
+return: 0 - context was not activated
+        1 - context is activated
+**********************************************************/
+byte IpSockets::Attach(const char *apn)
+{
+  byte ret_val = 0;
+
+  if (CLS_FREE != at.GetCommLineStatus()) return (ret_val);
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  ResetConns();
+  ip_state = IP_DOWN;
+
+  // start from the initial state of the TCP/IP stack
+  at.SendATCmdWaitResp(ATC_CIPSHUT);
+  at.SendATCmdWaitResp(ATC_CIPMUX_MULTI);  // multi connection
+  at.SendATCmdWaitResp(ATC_CIPRXGET); // data are fetched manually
+  at.SendATCmdWaitResp(ATC_CIPQSEND); // DATA ACCEPT without waiting for the remote ACK
+
+  if (IpActivate(at, apn)) {
+    ip_state = IP_UP;
+    ret_val = 1;
+  }
+
+  at.SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method closes all connections and deactivates the context
+**********************************************************/
+void IpSockets::Detach(void)
+{
+  if (CLS_FREE != at.GetCommLineStatus()) return;
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  at.SendATCmdWaitResp(ATC_CIPSHUT);
+  ip_state = IP_DOWN;
+  ResetConns();
+
+  at.SetCommLineStatus(CLS_FREE);
+}
+
+/**********************************************************
+Method starts opening of the connection
+- method does not wait for the connection, its state is
+  updated from the <n>, CONNECT OK URC (see GetState())
+
+proto: IP_TCP, IP_UDP
+host:  domain name or IP address string
+port:  remote port
+
+return: -1 - connection cannot be opened
+        0..IP_CONN_COUNT-1 - id of the connection
+**********************************************************/
+char IpSockets::Connect(byte proto, const char *host, uint16_t port)
+{
+  char id;
+
+  if (ip_state != IP_UP) return (-1);
+  for (id = 0; id < IP_CONN_COUNT; id++) {
+    if (conns[(byte)id].state == CONN_CLOSED && !conns[(byte)id].rx_count) break;
+  }
+  if (id == IP_CONN_COUNT) return (-1);
+
+  if (CLS_FREE != at.GetCommLineStatus()) return (-1);
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  // AT+CIPSTART=<n>,"TCP","<host>",<port>
+  conns[(byte)id].state = CONN_CONNECTING;
+  at.Port().print(F("AT+CIPSTART="));
+  at.Port().print((int)id);
+  if (proto == IP_UDP) at.Port().print(F(",\"UDP\",\""));
+  else at.Port().print(F(",\"TCP\",\""));
+  at.Port().print(host);
+  at.Port().print(F("\","));
+  at.Port().println(port);
+
+  // OK is followed later by the <n>, CONNECT OK URC
+  if (RX_FINISHED_STR_RECV != at.WaitResp(2000, 100, F("OK"))) {
+    conns[(byte)id].state = CONN_CLOSED;
+    id = -1;
+  }
+
+  at.SetCommLineStatus(CLS_FREE);
+  return (id);
+}
+
+/**********************************************************
+Method closes the connection
+- data already received can be still read
+**********************************************************/
+void IpSockets::Close(byte id)
+{
+  if (id >= IP_CONN_COUNT || conns[id].state == CONN_CLOSED) return;
+  if (CLS_FREE != at.GetCommLineStatus()) return;
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  // AT+CIPCLOSE=<n>,1 - quick close
+  at.Port().print(F("AT+CIPCLOSE="));
+  at.Port().print((int)id);
+  at.Port().println(F(",1"));
+  at.WaitResp(2000, 100);
+  conns[id].state = CONN_CLOSED;
+  conns[id].rx_pending = 0;
+
+  at.SetCommLineStatus(CLS_FREE);
+}
+
+/**********************************************************
+Method sends data over the connection and waits until the
+module accepts them
+- the module accepts the data without waiting for the 
+  acknowledge from the remote side (AT+CIPQSEND=1)
+
+return: -1 - data were not sent
+        num. of bytes sent (max. IP_SEND_MAX)
+**********************************************************/
+int IpSockets::Send(byte id, const byte *data, uint16_t len)
+{
+  eResp resp;
+  int n;
+
+  n = SendStart(id, data, len);
+  if (n <= 0) return (n);
+  do {
+    resp = SendCheck();
+  } while (resp == RESP_WAIT);
+  return (resp == RESP_OK ? n : -1);
+}
+
+/**********************************************************
+Method sends len bytes taken from the source by one
+AT+CIPSEND and waits until the module accepts them
+- no buffer for the data is needed
+
+return: -1 - data were not sent (also if the source gave
+             less than len bytes, zeros were sent instead)
+        num. of bytes sent
+**********************************************************/
+int IpSockets::Send(byte id, uint16_t len, ip_source_t source, void *context)
+{
+  eResp resp;
+  int n;
+
+  n = SendStart(id, len, source, context);
+  if (n <= 0) return (n);
+  do {
+    resp = SendCheck();
+  } while (resp == RESP_WAIT);
+  return (resp == RESP_OK ? n : -1);
+}
+
+/**********************************************************
+Method starts sending data over the connection, SendCheck()
+finishes it
+AT+CIPSEND=<n>,<length> => "> " => data => DATA ACCEPT:<n>,<length>
+
+data must stay valid until SendCheck() finishes
+
+return: -1 - sending was not started
+        num. of bytes to be sent (max. IP_SEND_MAX)
+**********************************************************/
+int IpSockets::SendStart(byte id, const byte *data, uint16_t len)
+{
+  if (id >= IP_CONN_COUNT || conns[id].state != CONN_CONNECTED) return (-1);
+  if (len == 0) return (0);
+  if (len > IP_SEND_MAX) len = IP_SEND_MAX;
+  if (CLS_FREE != at.GetCommLineStatus()) return (-1);
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  send_id = id;
+  send_data = data;
+  send_source = NULL;
+  send_len = len;
+  send_short = 0;
+  send_state = SEND_PROMPT;
+
+  at.Port().print(F("AT+CIPSEND="));
+  at.Port().print((int)id);
+  at.Port().print(',');
+  at.Port().println(len);
+  at.StartRx(1000, 50);
+  return (len);
+}
+
+/**********************************************************
+Method starts sending len bytes taken from the source, the
+data are taken when the module asks for them
+
+return: -1 - sending was not started (len is over IP_SEND_MAX)
+        num. of bytes to be sent
+**********************************************************/
+int IpSockets::SendStart(byte id, uint16_t len, ip_source_t source, void *context)
+{
+  int n;
+
+  if (len > IP_SEND_MAX) return (-1);
+  n = SendStart(id, NULL, len);
+  if (n > 0) {
+    send_source = source;
+    send_context = context;
+  }
+  return (n);
+}
+
+/**********************************************************
+Method writes send_len bytes of the source to the module,
+the module waits for all of them, so the missing ones are
+replaced by zeros
+
+return: 0 - source gave less bytes
+        1 - all bytes were written
+**********************************************************/
+byte IpSockets::WriteSource(void)
+{
+  byte buf[32];
+  uint16_t left = send_len;
+  uint16_t n;
+
+  while (left) {
+    n = send_source(send_context, (char *)buf, left < sizeof(buf) ? left : sizeof(buf));
+    if (n == 0) break;
+    at.Port().write(buf, n);
+    left -= n;
+  }
+  if (left == 0) return (1);
+  while (left--) at.Port().write((uint8_t)0);
+  return (0);
+}
+
+/**********************************************************
+Method continues sending started by SendStart(), it never
+waits - to be called until it returns other than RESP_WAIT
+
+return: RESP_WAIT - sending is not finished yet
+        RESP_OK   - module accepted the data
+        RESP_FAIL - data were not sent
+**********************************************************/
+eResp IpSockets::SendCheck(void)
+{
+  eResp rcode = RESP_WAIT;
+  byte status;
+
+  if (send_state == SEND_IDLE) return (RESP_FAIL);
+  status = at.IsRxFinished();
+  if (status == RX_NOT_FINISHED) return (RESP_WAIT);
+  if (status == RX_FINISHED) at.DispatchUrcs();
+
+  if (send_state == SEND_PROMPT) {
+    if (status == RX_FINISHED && at.IsStringReceived(F(">"))) {
+      if (send_source != NULL) send_short = !WriteSource();
+      else at.Port().write(send_data, send_len);
+      at.StartRx(5000, 100);
+      send_state = SEND_ACCEPT;
+    }
+    else rcode = RESP_FAIL;
+  }
+  else {
+    if (status == RX_FINISHED && at.IsStringReceived(F("DATA ACCEPT")) && !send_short) rcode = RESP_OK;
+    else rcode = RESP_FAIL;
+  }
+
+  if (rcode != RESP_WAIT) {
+    send_state = SEND_IDLE;
+    at.SetCommLineStatus(CLS_FREE);
+  }
+  return (rcode);
+}
+
+/**********************************************************
+Method fetches data notified by the module into the ring
++CIPRXGET: 2,<n>,<len>,<remaining><CR><LF><len bytes of data><CR><LF>OK
+
+comm line must be already reserved by the caller
+**********************************************************/
+void IpSockets::Fetch(byte id)
+{
+  ip_conn_t *conn = &conns[id];
+  byte space = IP_RX_BUF_LEN - conn->rx_count;
+  byte n;
+  byte i;
+  const char *p_start;
+  const char *p_data;
+
+  if (space > at.comm_buf_size - IP_RXGET_OVERHEAD) space = at.comm_buf_size - IP_RXGET_OVERHEAD;
+  if (space == 0) return;
+
+  at.Port().print(F("AT+CIPRXGET=2,"));
+  at.Port().print((int)id);
+  at.Port().print(',');
+  at.Port().println((int)space);
+  at.UseTiming(ATT_CIPRXGET);
+  if (RX_FINISHED != at.WaitResp(1000, 50)) return;
+
+  p_start = at.FindToken(AT_TOK_CIPRXGET);
+  if (p_start == NULL) {
+    // e.g. ERROR - nothing to read any more
+    conn->rx_pending = 0;
+    return;
+  }
+  p_start = strchr(p_start, ',');                 // <n>
+  if (p_start != NULL) p_start = strchr(p_start + 1, ','); // <len>
+  if (p_start == NULL) return;
+  n = atoi(p_start + 1);
+  p_start = strchr(p_start + 1, ',');             // <remaining>
+  conn->rx_pending = (p_start != NULL && atoi(p_start + 1) > 0);
+
+  p_data = strchr(p_start != NULL ? p_start : (char *)(at.comm_buf), 0x0a);
+  if (p_data == NULL || n > space) return;
+  p_data++;
+  if (p_data + n > (const char *)(at.comm_buf) + at.comm_buf_len) return;
+
+  for (i = 0; i < n; i++) {
+    conn->rx_buf[conn->rx_head] = p_data[i];
+    conn->rx_head = (conn->rx_head + 1) % IP_RX_BUF_LEN;
+  }
+  conn->rx_count += n;
+}
+
+/**********************************************************
+Method fetches received data into the rings of connections
+- must be called regularly - e.g. from the loop() after
+  the GSM::Poll()
+**********************************************************/
+void IpSockets::Service(void)
+{
+  byte id;
+
+  for (id = 0; id < IP_CONN_COUNT; id++) {
+    if (!conns[id].rx_pending || conns[id].rx_count == IP_RX_BUF_LEN) continue;
+    if (CLS_FREE != at.GetCommLineStatus()) return;
+    at.SetCommLineStatus(CLS_ATCMD);
+    Fetch(id);
+    at.SetCommLineStatus(CLS_FREE);
+  }
+}
+
+/**********************************************************
+Methods read the received data from the ring - no 
+communication with the module
+
+Available() return: num. of bytes which can be read
+Read() return:      -1 - no data, otherwise the next byte
+**********************************************************/
+int IpSockets::Available(byte id)
+{
+  if (id >= IP_CONN_COUNT) return (0);
+  return (conns[id].rx_count);
+}
+
+int IpSockets::Read(byte id)
+{
+  byte c;
+
+  if (id >= IP_CONN_COUNT || !conns[id].rx_count) return (-1);
+  ip_conn_t *conn = &conns[id];
+  c = conn->rx_buf[(conn->rx_head + IP_RX_BUF_LEN - conn->rx_count) % IP_RX_BUF_LEN];
+  conn->rx_count--;
+  return (c);
+}
+
+uint16_t IpSockets::Read(byte id, byte *buf, uint16_t len)
+{
+  uint16_t n = 0;
+  int c;
+
+  while (n < len && (c = Read(id)) >= 0) buf[n++] = c;
+  return (n);
+}
@@ -0,0 +1,146 @@
+/*
+sqrl_ip.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_IP_H
+#define __SQRL_IP_H
+
+#include "Arduino.h"
+#include <avr/pgmspace.h>
+#include "sqrl_at.h"
+
+// num. of connections supported by the module in the AT+CIPMUX=1 mode
+#define IP_CONN_MAX         8
+
+// num. of connections used by the library - every connection
+// has its own receive ring so keep it low on small boards
+#ifndef IP_CONN_COUNT
+#define IP_CONN_COUNT       2
+#endif
+#if IP_CONN_COUNT > IP_CONN_MAX
+#error "IP_CONN_COUNT is over the num. of connections of the module (IP_CONN_MAX)"
+#endif
+
+// size of the receive ring of one connection (max. 255)
+#ifndef IP_RX_BUF_LEN
+#define IP_RX_BUF_LEN       64
+#endif
+
+// max. num. of bytes sent by one AT+CIPSEND
+#define IP_SEND_MAX         1460
+
+// max. num. of bytes fetched by one AT+CIPRXGET=2 is the comm buffer
+// length minus this - header and trailer of the response must fit too
+#define IP_RXGET_OVERHEAD   40
+
+enum ip_proto_enum {
+  IP_TCP = 0,
+  IP_UDP
+};
+
+enum ip_state_enum {
+  IP_DOWN = 0,        // GPRS context is not activated
+  IP_UP               // context is activated, connections can be opened
+};
+
+enum ip_send_state_enum {
+  SEND_IDLE = 0,
+  SEND_PROMPT,        // AT+CIPSEND sent, waiting for "> "
+  SEND_ACCEPT         // data sent, waiting for DATA ACCEPT
+};
+
+enum ip_conn_state_enum {
+  CONN_CLOSED = 0,
+  CONN_CONNECTING,    // AT+CIPSTART accepted, waiting for <n>, CONNECT OK
+  CONN_CONNECTED
+};
+
+struct ip_conn_t {
+  byte state;
+  byte rx_pending;            // module has data which were not fetched yet
+  byte rx_head;               // next write position in the ring
+  byte rx_count;              // num. of bytes in the ring
+  byte rx_buf[IP_RX_BUF_LEN];
+};
+
+/**********************************************************
+  Source of data sent by Send() without a buffer
+
+  context - pointer passed together with the source
+  buf     - place for the next part of the data
+  max_len - max. num. of bytes of the part
+
+  return: num. of bytes placed into buf, 0 - no more data
+**********************************************************/
+typedef uint16_t (*ip_source_t)(void *context, char *buf, uint16_t max_len);
+
+byte IpActivate(AtComms &at, const char *apn);
+
+/**********************************************************
+  TCP/UDP sockets of the module TCP/IP stack
+
+  Up to IP_CONN_COUNT connections can be open at once 
+  (AT+CIPMUX=1). Received data are NOT pushed by the module,
+  the module only notifies them (AT+CIPRXGET=1 mode) and 
+  Service() fetches them into the receive ring of the 
+  connection while there is free space, so no data are lost
+  because of the size of the comm buffer.
+
+  URCs are read by the GSM::Poll() so it must be called
+  regularly together with Service().
+
+  Send() blocks until the module accepts the data (up to 6 s).
+  SendStart() and SendCheck() do the same without waiting,
+  the comm line is reserved until SendCheck() finishes:
+
+    if (sockets.SendStart(id, data, len) > 0) {
+      while (RESP_WAIT == sockets.SendCheck()) DoOtherWork();
+    }
+**********************************************************/
+class IpSockets {
+  private:
+    AtComms &at;
+    byte ip_state;
+    ip_conn_t conns[IP_CONN_COUNT];
+
+    byte send_state;
+    byte send_id;
+    const byte *send_data;      // must stay valid until SendCheck() finishes
+    ip_source_t send_source;    // used instead of send_data if not NULL
+    void *send_context;
+    uint16_t send_len;
+    byte send_short;            // source gave less than send_len bytes
+
+    byte WriteSource(void);
+
+    void ResetConns(void);
+    void Fetch(byte id);
+    byte ParseConnUrc(byte token, const char *line, byte line_len);
+
+    static byte UrcHandler(void *context, byte token, const char *line, byte len);
+
+  public:
+    IpSockets(AtComms &comms);
+
+    byte Attach(const char *apn);
+    void Detach(void);
+    inline byte IsAttached(void) {return (ip_state == IP_UP);};
+    void Service(void);
+
+    char Connect(byte proto, const char *host, uint16_t port);
+    inline byte GetState(byte id) {return (id < IP_CONN_COUNT ? conns[id].state : (byte)CONN_CLOSED);};
+    void Close(byte id);
+
+    int Send(byte id, const byte *data, uint16_t len);
+    int Send(byte id, uint16_t len, ip_source_t source, void *context);
+    int SendStart(byte id, const byte *data, uint16_t len);
+    int SendStart(byte id, uint16_t len, ip_source_t source, void *context);
+    eResp SendCheck(void);
+    int Available(byte id);
+    int Read(byte id);
+    uint16_t Read(byte id, byte *buf, uint16_t len);
+};
+
+#endif
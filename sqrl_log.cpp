@@ -0,0 +1,162 @@
+/*
+sqrl_log.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_log.h"
+
+#if SQRL_LOG_LEVEL > SQRL_LOG_NONE
+
+#include <avr/pgmspace.h>
+
+#define SQRL_LOG_MASK       (SQRL_LOG_RING_LEN - 1)
+// <millis> <tag><space> and <LF>
+#define SQRL_LOG_HEADER_LEN 14
+
+byte SqrlLog::ring[SQRL_LOG_RING_LEN];
+volatile byte SqrlLog::head = 0;
+volatile byte SqrlLog::tail = 0;
+uint16_t SqrlLog::dropped = 0;
+Print *SqrlLog::sink = NULL;
+
+static char SqrlLogTag(byte cat)
+{
+  switch (cat) {
+    case SQRL_LOG_TX:   return ('>');
+    case SQRL_LOG_RX:   return ('<');
+    case SQRL_LOG_URC:  return ('U');
+    case SQRL_LOG_TIME: return ('T');
+  }
+  return ('G');
+}
+
+void SqrlLog::Put(char c)
+{
+  ring[head] = c;
+  head = (head + 1) & SQRL_LOG_MASK;
+}
+
+void SqrlLog::PutNum(unsigned long num)
+{
+  char digits[10];
+  byte n = 0;
+
+  do {
+    digits[n++] = '0' + (num % 10);
+    num /= 10;
+  } while (num);
+  while (n) Put(digits[--n]);
+}
+
+/**********************************************************
+Method starts a record of len characters (without the header)
+
+return: 0 - there is no space, the record was dropped
+        1 - header was written
+**********************************************************/
+byte SqrlLog::Begin(byte cat, byte len)
+{
+  byte space = (tail - head - 1) & SQRL_LOG_MASK;
+
+  if ((uint16_t)len + SQRL_LOG_HEADER_LEN > space) {
+    if (dropped < 0xffff) dropped++;
+    return (0);
+  }
+
+  PutNum(millis());
+  Put(' ');
+  Put(SqrlLogTag(cat));
+  Put(' ');
+  return (1);
+}
+
+/**********************************************************
+Method writes the text record
+**********************************************************/
+void SqrlLog::Text(byte cat, const __FlashStringHelper *text)
+{
+  const char *p = (const char *)text;
+  byte len = strlen_P(p);
+  char c;
+
+  if (!Begin(cat, len)) return;
+  while ((c = pgm_read_byte(p++)) != 0) Put(c);
+  Put('\n');
+}
+
+/**********************************************************
+Method writes the text record followed by the number
+**********************************************************/
+void SqrlLog::Num(byte cat, const __FlashStringHelper *text, long num)
+{
+  const char *p = (const char *)text;
+  byte len = strlen_P(p);
+  char c;
+
+  // text, space, sign and 10 digits
+  if (!Begin(cat, len + 12)) return;
+  while ((c = pgm_read_byte(p++)) != 0) Put(c);
+  Put(' ');
+  if (num < 0) {
+    Put('-');
+    num = -num;
+  }
+  PutNum((unsigned long)num);
+  Put('\n');
+}
+
+/**********************************************************
+Method writes received or sent data, <CR> and <LF> are
+written as \r and \n, other control characters as '.'
+- data which does not fit into the ring is cut, '~' marks it
+**********************************************************/
+void SqrlLog::Data(byte cat, const byte *data, byte len)
+{
+  byte space;
+  byte i;
+
+  if (!Begin(cat, 2)) return;
+  // space left for the data, '~' and <LF>
+  space = ((tail - head - 1) & SQRL_LOG_MASK) - 2;
+
+  for (i = 0; i < len; i++) {
+    if (data[i] == 0x0d || data[i] == 0x0a) {
+      if (space < 2) break;
+      Put('\\');
+      Put(data[i] == 0x0d ? 'r' : 'n');
+      space -= 2;
+    }
+    else {
+      if (space < 1) break;
+      if (data[i] < 0x20 || data[i] > 0x7e) Put('.');
+      else Put(data[i]);
+      space--;
+    }
+  }
+  if (i < len) Put('~');
+  Put('\n');
+}
+
+/**********************************************************
+Method writes the records from the ring to the sink
+- to be called from the loop(), never from the AT engine
+
+max_len: max. num. of characters written by one call
+
+return: num. of characters written
+**********************************************************/
+byte SqrlLog::Flush(byte max_len)
+{
+  byte n = 0;
+
+  if (sink == NULL) return (0);
+  while (tail != head && n < max_len) {
+    sink->write(ring[tail]);
+    tail = (tail + 1) & SQRL_LOG_MASK;
+    n++;
+  }
+  return (n);
+}
+
+#endif
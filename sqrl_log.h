@@ -0,0 +1,116 @@
+/*
+sqrl_log.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_LOG_H
+#define __SQRL_LOG_H
+
+#include "Arduino.h"
+
+/**********************************************************
+  Compile time logging
+
+  Records are selected by the level and the category at
+  compile time. Disabled records produce no code, with
+  SQRL_LOG_LEVEL == SQRL_LOG_NONE (the default) the whole
+  facility produces no code and takes no RAM.
+
+  Records are written into a RAM ring, the writer never waits.
+  The ring is drained to the sink (a Print, e.g. Serial1 or
+  SoftwareSerial - never the UART of the module) by
+  SqrlLog::Flush() called from the loop(). When the ring is
+  full the records are dropped and counted.
+
+  The ring has a single writer (the library) and a single
+  reader (Flush()), the indexes are bytes written only by
+  their owner, so no locking is needed.
+
+  Record: <millis> <tag> <text>[ <num>]<LF>
+  tags:   G - general, > - TX, < - RX, U - URC, T - timing
+
+  The level, categories and ring length are set in the build
+  flags or here, e.g.
+    -DSQRL_LOG_LEVEL=SQRL_LOG_DEBUG -DSQRL_LOG_CATS=SQRL_LOG_TX|SQRL_LOG_RX
+**********************************************************/
+
+// levels
+#define SQRL_LOG_NONE       0
+#define SQRL_LOG_ERROR      1
+#define SQRL_LOG_WARN       2
+#define SQRL_LOG_INFO       3
+#define SQRL_LOG_DEBUG      4
+
+// categories
+#define SQRL_LOG_GEN        0x01    // general library events
+#define SQRL_LOG_TX         0x02    // AT commands sent
+#define SQRL_LOG_RX         0x04    // responses received
+#define SQRL_LOG_URC        0x08    // lines consumed by URC handlers
+#define SQRL_LOG_TIME       0x10    // timeouts and latency
+#define SQRL_LOG_ALL        0x1f
+
+#ifndef SQRL_LOG_LEVEL
+#define SQRL_LOG_LEVEL      SQRL_LOG_NONE
+#endif
+
+#ifndef SQRL_LOG_CATS
+#define SQRL_LOG_CATS       SQRL_LOG_ALL
+#endif
+
+// length of the ring, power of 2 up to 256
+#ifndef SQRL_LOG_RING_LEN
+#define SQRL_LOG_RING_LEN   128
+#endif
+
+#define SQRL_LOG_ENABLED(level, cat) \
+  ((level) <= SQRL_LOG_LEVEL && ((cat) & (SQRL_LOG_CATS)))
+
+#if SQRL_LOG_LEVEL > SQRL_LOG_NONE
+
+#define SQRL_LOG(level, cat, text) \
+  do { if (SQRL_LOG_ENABLED(level, cat)) SqrlLog::Text(cat, text); } while (0)
+#define SQRL_LOG_NUM(level, cat, text, num) \
+  do { if (SQRL_LOG_ENABLED(level, cat)) SqrlLog::Num(cat, text, num); } while (0)
+#define SQRL_LOG_DATA(level, cat, data, len) \
+  do { if (SQRL_LOG_ENABLED(level, cat)) SqrlLog::Data(cat, (const byte *)(data), len); } while (0)
+
+class SqrlLog {
+  private:
+    static byte ring[SQRL_LOG_RING_LEN];
+    static volatile byte head;      // written by the writer only
+    static volatile byte tail;      // written by Flush() only
+    static uint16_t dropped;
+    static Print *sink;
+
+    static byte Begin(byte cat, byte len);
+    static void Put(char c);
+    static void PutNum(unsigned long num);
+
+  public:
+    static inline void SetSink(Print *log_sink) {sink = log_sink;};
+    static byte Flush(byte max_len = 255);
+    static inline uint16_t Dropped(void) {return dropped;};
+
+    static void Text(byte cat, const __FlashStringHelper *text);
+    static void Num(byte cat, const __FlashStringHelper *text, long num);
+    static void Data(byte cat, const byte *data, byte len);
+};
+
+#else
+
+#define SQRL_LOG(level, cat, text)              do {} while (0)
+#define SQRL_LOG_NUM(level, cat, text, num)     do {} while (0)
+#define SQRL_LOG_DATA(level, cat, data, len)    do {} while (0)
+
+// the sketch can keep SetSink()/Flush() when logging is disabled
+class SqrlLog {
+  public:
+    static inline void SetSink(Print *log_sink) {};
+    static inline byte Flush(byte max_len = 255) {return 0;};
+    static inline uint16_t Dropped(void) {return 0;};
+};
+
+#endif
+
+#endif
@@ -0,0 +1,255 @@
+/*
+sqrl_nmea.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_nmea.h"
+
+extern "C" {
+  #include <string.h>
+}
+
+// parser states
+#define NMEA_ST_IDLE    0   // waiting for '$'
+#define NMEA_ST_FIELDS  1   // between '$' and '*'
+#define NMEA_ST_CS_HI   2   // first checksum digit
+#define NMEA_ST_CS_LO   3   // second checksum digit
+
+NmeaParser::NmeaParser(void) {
+  handler = NULL;
+  handler_ctx = NULL;
+  Reset();
+}
+
+/**********************************************************
+Method forgets the fix and the sentence in progress
+**********************************************************/
+void NmeaParser::Reset(void) {
+  memset(&fix, 0, sizeof(fix));
+  fix.fix = GPS_FIX_UNKNOWN;
+  state = NMEA_ST_IDLE;
+  sentences_ok = 0;
+  sentences_err = 0;
+}
+
+// hex digit value, 0xff - not a hex digit
+static byte NmeaHex(char c)
+{
+  if (c >= '0' && c <= '9') return (c - '0');
+  if (c >= 'A' && c <= 'F') return (c - 'A' + 10);
+  if (c >= 'a' && c <= 'f') return (c - 'a' + 10);
+  return (0xff);
+}
+
+/**********************************************************
+Method processes one character from the GPS UART
+
+c: received character
+
+return: NMEA_NONE         - sentence in progress or not used
+        NMEA_SENTENCE     - sentence merged to the fix
+        NMEA_FIX          - RMC merged, epoch complete (the
+                            handler was called)
+        NMEA_ERR_CHECKSUM - sentence dropped
+**********************************************************/
+byte NmeaParser::Feed(char c)
+{
+  byte v;
+
+  if (c == '$') {
+    if (state != NMEA_ST_IDLE) sentences_err++;  // previous one was cut
+    stage = fix;
+    field_len = 0;
+    field_idx = 0;
+    sentence = NMEA_SNT_UNKNOWN;
+    checksum = 0;
+    state = NMEA_ST_FIELDS;
+    return (NMEA_NONE);
+  }
+
+  switch (state) {
+    case NMEA_ST_FIELDS:
+      if (c == '*') {
+        ParseField();
+        rx_checksum = 0;
+        state = NMEA_ST_CS_HI;
+      }
+      else if (c < ' ' || c > '~') {
+        // end of line or noise before the checksum
+        state = NMEA_ST_IDLE;
+        sentences_err++;
+        return (NMEA_ERR_CHECKSUM);
+      }
+      else {
+        checksum ^= c;
+        if (c == ',') {
+          ParseField();
+          if (sentence == NMEA_SNT_UNKNOWN) {
+            // not used - skip the rest of the sentence
+            state = NMEA_ST_IDLE;
+            break;
+          }
+          field_idx++;
+          field_len = 0;
+        }
+        else if (field_len < NMEA_FIELD_LEN) {
+          field[field_len++] = c;
+        }
+      }
+      break;
+
+    case NMEA_ST_CS_HI:
+    case NMEA_ST_CS_LO:
+      v = NmeaHex(c);
+      if (v == 0xff) {
+        state = NMEA_ST_IDLE;
+        sentences_err++;
+        return (NMEA_ERR_CHECKSUM);
+      }
+      rx_checksum = (rx_checksum << 4) | v;
+      if (state == NMEA_ST_CS_HI) {
+        state = NMEA_ST_CS_LO;
+        break;
+      }
+      state = NMEA_ST_IDLE;
+      return (EndSentence());
+  }
+  return (NMEA_NONE);
+}
+
+/**********************************************************
+Method merges the staging fix after the checksum was read
+**********************************************************/
+byte NmeaParser::EndSentence(void)
+{
+  if (rx_checksum != checksum) {
+    sentences_err++;
+    return (NMEA_ERR_CHECKSUM);
+  }
+
+  fix = stage;
+  sentences_ok++;
+  if (sentence != NMEA_SNT_RMC) return (NMEA_SENTENCE);
+
+  if (handler != NULL) handler(handler_ctx, fix);
+  return (NMEA_FIX);
+}
+
+/**********************************************************
+Method parses the field just finished to the staging fix
+- empty fields do not change the staging fix
+
+GGA,hhmmss.sss,ddmm.mmmm,N,dddmm.mmmm,E,q,nn,hdop,alt,M,...
+GSA,A,f,...
+RMC,hhmmss.sss,A,ddmm.mmmm,N,dddmm.mmmm,E,knots,course,ddmmyy,...
+VTG,course,T,course,M,knots,N,kmh,K,...
+**********************************************************/
+void NmeaParser::ParseField(void)
+{
+  long value;
+  const char *p;
+  byte idx;
+
+  field[field_len] = 0;
+
+  if (field_idx == 0) {
+    // address field - talker ID and sentence type
+    sentence = NMEA_SNT_UNKNOWN;
+    if (field_len != 5) return;
+    p = field + 2;
+    if (p[0] == 'G' && p[1] == 'G' && p[2] == 'A') sentence = NMEA_SNT_GGA;
+    else if (p[0] == 'G' && p[1] == 'S' && p[2] == 'A') sentence = NMEA_SNT_GSA;
+    else if (p[0] == 'R' && p[1] == 'M' && p[2] == 'C') sentence = NMEA_SNT_RMC;
+    else if (p[0] == 'V' && p[1] == 'T' && p[2] == 'G') sentence = NMEA_SNT_VTG;
+    return;
+  }
+  if (field_len == 0) return;
+
+  // the RMC fields from the status on are shifted by one
+  // against GGA, so both are mapped to GGA numbering
+  idx = field_idx;
+  if (sentence == NMEA_SNT_RMC) {
+    if (idx == 2) {
+      if (field[0] == 'V') stage.fix = GPS_FIX_NONE;
+      else if (field[0] == 'A' && stage.fix < GPS_FIX_2D) stage.fix = GPS_FIX_2D;
+      return;
+    }
+    if (idx >= 3 && idx <= 6) idx--;
+  }
+
+  switch (sentence) {
+    case NMEA_SNT_GGA:
+    case NMEA_SNT_RMC:
+      switch (idx) {
+        case 1: // hhmmss.sss
+          p = GpsParseDigits(field, 2, stage.hour);
+          if (p != NULL) p = GpsParseDigits(p, 2, stage.minute);
+          if (p != NULL) GpsParseDigits(p, 2, stage.second);
+          return;
+        case 2:
+          GpsParseCoord(field, stage.pos.lat);
+          return;
+        case 3:
+          if (field[0] == 'S') stage.pos.lat = -stage.pos.lat;
+          return;
+        case 4:
+          GpsParseCoord(field, stage.pos.lon);
+          return;
+        case 5:
+          if (field[0] == 'W') stage.pos.lon = -stage.pos.lon;
+          return;
+      }
+      if (sentence == NMEA_SNT_GGA) {
+        switch (idx) {
+          case 6: // fix quality
+            if (field[0] == '0') stage.fix = GPS_FIX_NONE;
+            else if (stage.fix < GPS_FIX_2D) stage.fix = GPS_FIX_2D;
+            break;
+          case 7:
+            if (GpsParseFixed(field, 0, value) != NULL) stage.sats = value;
+            break;
+          case 9:
+            GpsParseFixed(field, 2, stage.alt_cm);
+            break;
+        }
+      }
+      else {
+        switch (idx) {
+          case 7: // speed in 0.001 knots
+            if (GpsParseFixed(field, 3, value) != NULL) {
+              stage.speed_cms = (value * 1286 + 12500) / 25000;
+            }
+            break;
+          case 8:
+            if (GpsParseFixed(field, 2, value) != NULL) stage.course_cdeg = value % 36000;
+            break;
+          case 9: // ddmmyy
+            p = GpsParseDigits(field, 2, stage.day);
+            if (p != NULL) p = GpsParseDigits(p, 2, stage.month);
+            if (p != NULL) GpsParseDigits(p, 2, stage.year);
+            break;
+        }
+      }
+      break;
+
+    case NMEA_SNT_GSA:
+      if (idx == 2) {
+        if (field[0] == '1') stage.fix = GPS_FIX_NONE;
+        else if (field[0] == '2') stage.fix = GPS_FIX_2D;
+        else if (field[0] == '3') stage.fix = GPS_FIX_3D;
+      }
+      break;
+
+    case NMEA_SNT_VTG:
+      if (idx == 1) {
+        if (GpsParseFixed(field, 2, value) != NULL) stage.course_cdeg = value % 36000;
+      }
+      else if (idx == 5) {
+        if (GpsParseFixed(field, 3, value) != NULL) {
+          stage.speed_cms = (value * 1286 + 12500) / 25000;
+        }
+      }
+      break;
+  }
+}
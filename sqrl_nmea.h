@@ -0,0 +1,96 @@
+/*
+sqrl_nmea.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_NMEA_H
+#define __SQRL_NMEA_H
+
+#include "Arduino.h"
+#include "sqrl_gps.h"
+
+// sentence mask for AT+CGPSOUT=<mask>
+#define NMEA_OUT_GGA    2
+#define NMEA_OUT_GLL    4
+#define NMEA_OUT_GSA    8
+#define NMEA_OUT_GSV    16
+#define NMEA_OUT_RMC    32
+#define NMEA_OUT_VTG    64
+#define NMEA_OUT_ZDA    128
+// all sentences used by NmeaParser
+#define NMEA_OUT_FIX    (NMEA_OUT_GGA | NMEA_OUT_GSA | NMEA_OUT_RMC | NMEA_OUT_VTG)
+
+// longest field kept by the parser, longer fields are truncated
+// - ddmm.mmmmmm or dddmm.mmmmmm fits
+#define NMEA_FIELD_LEN  12
+
+// return values of NmeaParser::Feed()
+enum nmea_feed_enum {
+  NMEA_NONE = 0,      // sentence is in progress or was not used
+  NMEA_SENTENCE,      // sentence was validated and merged to the fix
+  NMEA_FIX,           // RMC sentence was merged - the fix of the epoch is complete
+  NMEA_ERR_CHECKSUM   // sentence was dropped because of bad checksum or format
+};
+
+enum nmea_sentence_enum {
+  NMEA_SNT_UNKNOWN = 0,
+  NMEA_SNT_GGA,
+  NMEA_SNT_GSA,
+  NMEA_SNT_RMC,
+  NMEA_SNT_VTG
+};
+
+// called by Feed() when the fix of an epoch is complete
+typedef void (*nmea_fix_handler_t)(void *context, const gps_fix_t &fix);
+
+/**********************************************************
+  Incremental NMEA 0183 parser
+
+  Characters are fed one by one as they arrive from the GPS
+  UART, so no sentence buffer is needed. Each field is parsed
+  when its terminating ',' or '*' arrives, into a staging
+  copy of the fix. The staging copy is merged to the fix only
+  when the checksum of the whole sentence matches, so a
+  corrupted sentence never changes the fix.
+
+  GGA - position, altitude, satellites
+  GSA - 2D/3D fix type
+  RMC - position, date and time, speed, course (ends epoch)
+  VTG - speed, course
+
+  Any talker ID is accepted ($GP, $GN, $GL...).
+**********************************************************/
+class NmeaParser {
+  private:
+    gps_fix_t fix;          // last complete data
+    gps_fix_t stage;        // data of the sentence in progress
+    nmea_fix_handler_t handler;
+    void *handler_ctx;
+
+    char field[NMEA_FIELD_LEN + 1];
+    byte field_len;
+    byte field_idx;         // 0 - address field, 1.. - data fields
+    byte sentence;          // nmea_sentence_enum
+    byte state;
+    byte checksum;
+    byte rx_checksum;
+
+    uint16_t sentences_ok;
+    uint16_t sentences_err;
+
+    void ParseField(void);
+    byte EndSentence(void);
+
+  public:
+    NmeaParser(void);
+
+    void Reset(void);
+    byte Feed(char c);
+    inline void SetHandler(nmea_fix_handler_t h, void *context) {handler = h; handler_ctx = context;};
+    inline const gps_fix_t& GetFix(void) {return fix;};
+    inline uint16_t GetSentencesOk(void) {return sentences_ok;};
+    inline uint16_t GetSentencesErr(void) {return sentences_err;};
+};
+
+#endif
@@ -0,0 +1,218 @@
+/*
+sqrl_pipe.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_pipe.h"
+#include <avr/pgmspace.h>
+
+// lines sent by the module when the connection is closed in the data mode
+static const char pipe_closed_str[] PROGMEM = "\r\nCLOSED\r\n";
+static const char pipe_carrier_str[] PROGMEM = "\r\nNO CARRIER\r\n";
+
+IpPipe::IpPipe(AtComms &comms) : at(comms) {
+  state = PIPE_CLOSED;
+  last_tx = 0;
+  closed_pos = 0;
+  carrier_pos = 0;
+}
+
+/**********************************************************
+Method opens the transparent connection
+
+apn:   access point name, e.g. "internet"
+proto: IP_TCP, IP_UDP
+host:  domain name or IP address string
+port:  remote port
+
+return: 0 - connection was not opened
+        1 - connection is open and the pipe is in PIPE_DATA state
+**********************************************************/
+byte IpPipe::Open(const char *apn, byte proto, const char *host, uint16_t port)
+{
+  byte ret_val = 0;
+
+  if (state != PIPE_CLOSED) return (ret_val);
+  if (CLS_FREE != at.GetCommLineStatus()) return (ret_val);
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  // start from the initial state of the TCP/IP stack
+  at.SendATCmdWaitResp(ATC_CIPSHUT);
+  at.SendATCmdWaitResp(ATC_CIPMUX_SINGLE);
+  at.SendATCmdWaitResp(ATC_CIPMODE_TRANS);
+
+  if (IpActivate(at, apn)) {
+    // AT+CIPSTART="TCP","<host>",<port> => OK => CONNECT
+    if (proto == IP_UDP) at.Port().print(F("AT+CIPSTART=\"UDP\",\""));
+    else at.Port().print(F("AT+CIPSTART=\"TCP\",\""));
+    at.Port().print(host);
+    at.Port().print(F("\","));
+    at.Port().println(port);
+
+    if (RX_FINISHED_STR_RECV == at.WaitResp(2000, 100, F("OK"))
+        // Wait for CONNECT unless it came with OK
+        && (at.HasToken(AT_TOK_CONNECT)
+            || RX_FINISHED_STR_RECV == at.WaitResp(30000, 100, F("CONNECT\r\n")))) {
+      state = PIPE_DATA;
+      last_tx = millis();
+      closed_pos = carrier_pos = 0;
+      at.SetCommLineStatus(CLS_DATA);
+      return (1);
+    }
+  }
+
+  at.SetCommLineStatus(CLS_FREE);
+  return (ret_val);
+}
+
+/**********************************************************
+Method switches the module from the data mode to the
+command mode - the connection stays open
+
+<guard time> +++ <guard time> => OK
+
+- data received from the remote side during the escape
+  are discarded
+- nothing else is sent when +++ is not confirmed - the
+  module may still be in the data mode and would pass
+  it to the remote side
+
+return: 0 - module did not confirm the escape, the pipe
+            stays in PIPE_DATA state (Escape() can be
+            called again)
+        1 - pipe is in PIPE_COMMAND state, comm line is free
+**********************************************************/
+byte IpPipe::Escape(void)
+{
+  unsigned long silence;
+
+  if (state != PIPE_DATA) return (state == PIPE_COMMAND);
+
+  // no data can be sent within the guard time before +++
+  silence = (unsigned long)(millis() - last_tx);
+  if (silence < PIPE_GUARD_TIME) delay(PIPE_GUARD_TIME - silence);
+
+  at.Port().print(F("+++"));
+  last_tx = millis();
+
+  // module answers after the guard time after +++
+  if (RX_FINISHED_STR_RECV == at.WaitResp(PIPE_GUARD_TIME + 500, 100, F("OK"))) {
+    state = PIPE_COMMAND;
+    at.SetCommLineStatus(CLS_FREE);
+    return (1);
+  }
+  return (0);
+}
+
+/**********************************************************
+Method returns from the command mode back to the data mode
+
+return: 0 - data mode was not resumed
+        1 - pipe is in PIPE_DATA state
+**********************************************************/
+byte IpPipe::Resume(void)
+{
+  if (state != PIPE_COMMAND) return (state == PIPE_DATA);
+  if (CLS_FREE != at.GetCommLineStatus()) return (0);
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  if (AT_RESP_OK == at.SendATCmdWaitResp(ATC_ATO)) {
+    state = PIPE_DATA;
+    last_tx = millis();
+    closed_pos = carrier_pos = 0;
+    at.SetCommLineStatus(CLS_DATA);
+    return (1);
+  }
+
+  // connection was closed in the meantime
+  if (at.HasToken(AT_TOK_NO_CARRIER) || at.HasToken(AT_TOK_ERROR)) state = PIPE_CLOSED;
+  at.SetCommLineStatus(CLS_FREE);
+  return (0);
+}
+
+/**********************************************************
+Method closes the connection and deactivates the context
+
+return: 0 - the escape was not confirmed, the module may be
+            still in the data mode so the pipe stays in
+            PIPE_DATA state and the comm line in CLS_DATA
+            (call Close() again or restart the module)
+        1 - pipe is closed
+**********************************************************/
+byte IpPipe::Close(void)
+{
+  if (state == PIPE_CLOSED) return (1);
+  if (state == PIPE_DATA && !Escape()) return (0);
+  if (CLS_FREE != at.GetCommLineStatus()) return (0);
+  state = PIPE_CLOSED;
+  at.SetCommLineStatus(CLS_ATCMD);
+
+  at.SendATCmdWaitResp(ATC_CIPCLOSE_QUICK);
+  at.SendATCmdWaitResp(ATC_CIPSHUT);
+  at.SendATCmdWaitResp(ATC_CIPMODE_NORMAL);
+
+  at.SetCommLineStatus(CLS_FREE);
+  return (1);
+}
+
+/**********************************************************
+Methods transfer data of the connection - the serial line
+is used directly, there is no AT framing
+
+Write() return: num. of bytes written, 0 - pipe is not in 
+                the data mode
+**********************************************************/
+size_t IpPipe::Write(byte c)
+{
+  if (state != PIPE_DATA) return 0;
+  last_tx = millis();
+  return at.Port().write(c);
+}
+
+size_t IpPipe::Write(const byte *data, size_t len)
+{
+  if (state != PIPE_DATA) return 0;
+  last_tx = millis();
+  len = at.Port().write(data, len);
+  last_tx = millis();
+  return len;
+}
+
+int IpPipe::Available(void)
+{
+  if (state != PIPE_DATA) return 0;
+  return at.Port().available();
+}
+
+int IpPipe::Read(void)
+{
+  int c;
+
+  if (state != PIPE_DATA) return -1;
+  c = at.Port().read();
+  if (c >= 0) WatchLost(c);
+  return c;
+}
+
+static byte PipeMatch(const char *pattern, byte pos, byte c)
+{
+  if (c == pgm_read_byte(&pattern[pos])) return (pos + 1);
+  return (c == pgm_read_byte(&pattern[0]) ? 1 : 0);
+}
+
+/**********************************************************
+Method matches the read data with the lines sent by the
+module when the connection is closed, the module is in the
+command mode after them
+**********************************************************/
+void IpPipe::WatchLost(byte c)
+{
+  closed_pos = PipeMatch(pipe_closed_str, closed_pos, c);
+  carrier_pos = PipeMatch(pipe_carrier_str, carrier_pos, c);
+  if (closed_pos == sizeof(pipe_closed_str) - 1
+      || carrier_pos == sizeof(pipe_carrier_str) - 1) {
+    state = PIPE_LOST;
+    at.SetCommLineStatus(CLS_FREE);
+  }
+}
@@ -0,0 +1,70 @@
+/*
+sqrl_pipe.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_PIPE_H
+#define __SQRL_PIPE_H
+
+#include "Arduino.h"
+#include <avr/pgmspace.h>
+#include "sqrl_at.h"
+#include "sqrl_ip.h"
+
+// silence before and after the +++ escape sequence (msec.)
+// - must correspond to the guard time of the module (AT+CIPCCFG)
+#define PIPE_GUARD_TIME     1000
+
+enum pipe_state_enum {
+  PIPE_CLOSED = 0,
+  PIPE_DATA,          // connection is open, serial line is the raw data pipe
+  PIPE_COMMAND,       // connection is open, module is in the command mode (after escape)
+  PIPE_LOST           // connection was closed by the remote side, Close() releases the stack
+};
+
+/**********************************************************
+  Transparent TCP/UDP connection (AT+CIPMODE=1)
+
+  While the pipe is in the PIPE_DATA state the serial line
+  carries only the data of the connection and the comm line
+  status is CLS_DATA, so no AT command is sent by the library.
+  Escape() returns to the command mode by the +++ sequence
+  with the guard times, Resume() returns back by ATO.
+
+  When the remote side closes the connection the module
+  sends CLOSED (or NO CARRIER) and returns to the command
+  mode by itself. Read() watches the data for these lines
+  and the pipe goes to PIPE_LOST with the comm line free,
+  so data which contain such a line end the pipe too.
+
+  Transparent mode uses the single connection mode of the
+  stack so it cannot be used together with IpSockets.
+**********************************************************/
+class IpPipe {
+  private:
+    AtComms &at;
+    byte state;
+    unsigned long last_tx;  // millis() of the last byte sent to the pipe
+    byte closed_pos;        // num. of matched characters of CLOSED
+    byte carrier_pos;       // num. of matched characters of NO CARRIER
+
+    void WatchLost(byte c);
+
+  public:
+    IpPipe(AtComms &comms);
+
+    byte Open(const char *apn, byte proto, const char *host, uint16_t port);
+    byte Escape(void);
+    byte Resume(void);
+    byte Close(void);
+    inline byte GetState(void) {return state;};
+
+    // data - only in the PIPE_DATA state
+    size_t Write(byte c);
+    size_t Write(const byte *data, size_t len);
+    int Available(void);
+    int Read(void);
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+sqrl_ram.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_RAM_H
+#define __SQRL_RAM_H
+
+/**********************************************************
+  Compile time checks of the buffer sizes
+
+  SQRL_STATIC_ASSERT(cond, name) - compilation fails when cond
+  is false, the error names the array sqrl_assert_<name>
+**********************************************************/
+#define SQRL_STATIC_ASSERT(cond, name) \
+  typedef char sqrl_assert_##name[(cond) ? 1 : -1]
+
+/**********************************************************
+  Static RAM report
+
+  When SQRL_RAM_REPORT is defined (e.g. in the build flags)
+  every SQRL_REPORT_RAM(name, bytes) produces a compiler
+  warning with the num. of bytes, e.g.
+
+    'static void SqrlRamBytes<BYTES>::Report() [with unsigned int BYTES = 412]'
+    is deprecated
+
+  The library reports the GSM object with the default comm
+  buffer (GSM(void)) and every SizedGSM<N> the sketch creates
+  reports its own size, a sketch can report its own
+  configuration too:
+
+    SQRL_REPORT_RAM(my_gsm, sizeof(MyTracker))
+
+  Without SQRL_RAM_REPORT the macro produces nothing.
+**********************************************************/
+#ifdef SQRL_RAM_REPORT
+template <unsigned int BYTES>
+struct SqrlRamBytes {
+  __attribute__((deprecated)) static void Report(void) {};
+};
+
+#define SQRL_REPORT_RAM(name, bytes) \
+  static inline void sqrl_ram_report_##name(void) {SqrlRamBytes<(bytes)>::Report();}
+
+// the same inside a function (e.g. a constructor of a template)
+#define SQRL_REPORT_RAM_USE(bytes)  SqrlRamBytes<(bytes)>::Report()
+#else
+#define SQRL_REPORT_RAM(name, bytes)
+#define SQRL_REPORT_RAM_USE(bytes)
+#endif
+
+#endif
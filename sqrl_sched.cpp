@@ -0,0 +1,142 @@
+/*
+sqrl_sched.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_sched.h"
+
+extern "C" {
+  #include <math.h>
+}
+
+// metres per 1e-6 deg. of latitude (mean Earth radius)
+#define SCHED_M_PER_E6      (EARTH_MEAN_RADIUS * DEG_TO_RAD * 0.000001)
+
+GpsScheduler::GpsScheduler(GSM &gsm_module) : gsm(gsm_module) {
+  state = SCHED_IDLE;
+  woken = 0;
+  handler = NULL;
+  handler_ctx = NULL;
+}
+
+// distance in metres, flat approximation - used for short
+// distances only
+static long SchedDistance(const position_e6_t &from, const position_e6_t &to)
+{
+  double dy = (to.lat - from.lat) * SCHED_M_PER_E6;
+  double dx = (to.lon - from.lon) * SCHED_M_PER_E6 * cos(from.lat * (DEG_TO_RAD * 0.000001));
+
+  return (long)sqrt(dx * dx + dy * dy);
+}
+
+void GpsScheduler::SetState(byte new_state)
+{
+  state = new_state;
+  state_at = millis();
+  next_poll = state_at;
+}
+
+void GpsScheduler::Sleep(void)
+{
+  gsm.StopGPS();
+  SetState(SCHED_SLEEP);
+}
+
+/**********************************************************
+Method starts the scheduling, GPS is switched on
+**********************************************************/
+void GpsScheduler::Start(void)
+{
+  gsm.StartGPS();
+  woken = 0;
+  SetState(SCHED_ACQUIRE);
+}
+
+/**********************************************************
+Method stops the scheduling, GPS is switched off
+**********************************************************/
+void GpsScheduler::Stop(void)
+{
+  gsm.StopGPS();
+  SetState(SCHED_IDLE);
+}
+
+/**********************************************************
+Method returns the interval to the next poll (msec.)
+- SCHED_POLL_DIST divided by the speed within the limits
+**********************************************************/
+unsigned long GpsScheduler::Interval(const gps_fix_t &fix)
+{
+  unsigned long interval;
+
+  // speed in cm/s --> msec. to move SCHED_POLL_DIST metres
+  if (fix.speed_cms == 0) return (SCHED_POLL_MAX);
+  interval = (SCHED_POLL_DIST * 100000UL) / fix.speed_cms;
+  if (interval < SCHED_POLL_MIN) interval = SCHED_POLL_MIN;
+  if (interval > SCHED_POLL_MAX) interval = SCHED_POLL_MAX;
+  return (interval);
+}
+
+/**********************************************************
+Method runs the scheduler, it polls the fix when the poll
+is due and switches the GPS power
+
+fix: filled by the new fix
+
+return: GEN_SUCCESS - new valid fix (the handler was called)
+        GEN_FAILURE - no new fix
+**********************************************************/
+byte GpsScheduler::Service(gps_fix_t &fix)
+{
+  unsigned long now = millis();
+
+  switch (state) {
+    case SCHED_IDLE:
+      return (GEN_FAILURE);
+
+    case SCHED_SLEEP:
+      if ((unsigned long)(now - state_at) < SCHED_SLEEP_TIME) return (GEN_FAILURE);
+      gsm.StartGPS();
+      woken = 1;
+      SetState(SCHED_ACQUIRE);
+      return (GEN_FAILURE);
+  }
+
+  if ((long)(now - next_poll) < 0) return (GEN_FAILURE);
+
+  if (GEN_SUCCESS != gsm.CheckFix(fix)) {
+    if (state == SCHED_ACQUIRE && (unsigned long)(now - state_at) >= SCHED_ACQUIRE_TMOUT) {
+      // no sky - try again after the sleep
+      Sleep();
+    }
+    else {
+      next_poll = now + (state == SCHED_ACQUIRE ? SCHED_ACQUIRE_POLL : SCHED_POLL_MIN);
+    }
+    return (GEN_FAILURE);
+  }
+
+  if (state == SCHED_ACQUIRE) {
+    SetState(SCHED_TRACK);
+    if (woken && SchedDistance(still_pos, fix.pos) <= SCHED_STILL_RADIUS) {
+      // still at the same place
+      woken = 0;
+      Sleep();
+      if (handler != NULL) handler(handler_ctx, fix);
+      return (GEN_SUCCESS);
+    }
+    woken = 0;
+    still_pos = fix.pos;
+    still_since = now;
+  }
+  else if (SchedDistance(still_pos, fix.pos) > SCHED_STILL_RADIUS) {
+    still_pos = fix.pos;
+    still_since = now;
+  }
+
+  if ((unsigned long)(now - still_since) >= SCHED_STILL_TIME) Sleep();
+  else next_poll = now + Interval(fix);
+
+  if (handler != NULL) handler(handler_ctx, fix);
+  return (GEN_SUCCESS);
+}
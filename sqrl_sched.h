@@ -0,0 +1,85 @@
+/*
+sqrl_sched.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_SCHED_H
+#define __SQRL_SCHED_H
+
+#include "Arduino.h"
+#include "GSM_Shield.h"
+
+// polling interval limits (msec.)
+#define SCHED_POLL_MIN      2000
+#define SCHED_POLL_MAX      60000
+// distance to move between two polls (metres), the interval
+// is this distance divided by the speed
+#define SCHED_POLL_DIST     50
+// interval of the polls while waiting for a fix (msec.)
+#define SCHED_ACQUIRE_POLL  3000
+// max. time to wait for a fix after the power on (msec.)
+#define SCHED_ACQUIRE_TMOUT 90000
+// unit is stationary when it stays within the radius (metres)..
+#define SCHED_STILL_RADIUS  30
+// ..for this time (msec.)
+#define SCHED_STILL_TIME    120000
+// GPS is off for this time when stationary (msec.)
+#define SCHED_SLEEP_TIME    300000
+
+enum sched_state_enum {
+  SCHED_IDLE = 0,     // Start() was not called
+  SCHED_ACQUIRE,      // GPS is on, waiting for a fix
+  SCHED_TRACK,        // GPS is on, polled with the adaptive rate
+  SCHED_SLEEP         // GPS is off, unit is stationary
+};
+
+// called by Service() for every valid fix
+typedef void (*sched_fix_handler_t)(void *context, const gps_fix_t &fix);
+
+/**********************************************************
+  Adaptive GPS polling and power scheduler
+
+  The fix is polled by CheckFix() with the interval of
+  SCHED_POLL_DIST divided by the speed, so a moving unit
+  reports every ~50 m and a slow one is polled rarely.
+
+  When the unit stays within SCHED_STILL_RADIUS for the
+  SCHED_STILL_TIME the GPS power is switched off for the
+  SCHED_SLEEP_TIME. The GPS is only powered off, not reset,
+  so after the sleep it makes the hot start. If the first
+  fix after the sleep is still near the stationary position
+  the GPS is switched off again at once.
+
+  Service() must be called regularly, e.g. next to
+  GSM::Poll(), it sends no AT command until a poll is due.
+**********************************************************/
+class GpsScheduler {
+  private:
+    GSM &gsm;
+    byte state;
+    unsigned long state_at;     // millis() when the state was entered
+    unsigned long next_poll;    // millis() of the next poll
+    byte woken;                 // the first fix after the sleep is expected
+
+    position_e6_t still_pos;    // centre of the stationary area
+    unsigned long still_since;
+
+    sched_fix_handler_t handler;
+    void *handler_ctx;
+
+    void SetState(byte new_state);
+    void Sleep(void);
+    unsigned long Interval(const gps_fix_t &fix);
+
+  public:
+    GpsScheduler(GSM &gsm_module);
+
+    void Start(void);
+    void Stop(void);
+    byte Service(gps_fix_t &fix);
+    inline byte GetState(void) {return state;};
+    inline void SetHandler(sched_fix_handler_t h, void *context) {handler = h; handler_ctx = context;};
+};
+
+#endif
@@ -0,0 +1,243 @@
+/*
+sqrl_trace.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_trace.h"
+
+#define SQRL_TRACE_MASK     (SQRL_TRACE_RING_LEN - 1)
+
+TraceStream::TraceStream(Stream &stream) {
+  port = &stream;
+  head = 0;
+  tail = 0;
+  recording = 0;
+  lost = 0;
+  lost_total = 0;
+  prev_time = 0;
+  sink = NULL;
+}
+
+/**********************************************************
+Method starts a new session, records not flushed yet are
+discarded
+
+trace_sink: Print the records are flushed to
+**********************************************************/
+void TraceStream::Start(Print *trace_sink)
+{
+  sink = trace_sink;
+  head = 0;
+  tail = 0;
+  lost = 0;
+  lost_total = 0;
+  prev_time = millis();
+  recording = 1;
+}
+
+void TraceStream::Put(byte b)
+{
+  ring[head] = b;
+  head = (head + 1) & SQRL_TRACE_MASK;
+}
+
+/**********************************************************
+Method records one byte
+- if there is no space in the ring it is drained to the sink
+  at once (a response longer than the ring would not fit
+  between two Flush() calls from the loop())
+- without a sink the record is counted as lost and
+  TRACE_LOST is written before the next record
+**********************************************************/
+void TraceStream::Record(byte dir, byte data)
+{
+  unsigned long now;
+  unsigned long delta;
+  byte space;
+  byte need;
+
+  if (!recording) return;
+  now = millis();
+  delta = now - prev_time;
+  space = (tail - head - 1) & SQRL_TRACE_MASK;
+  need = (delta > TRACE_DELTA_MAX) ? 4 : 2;
+  if (lost) need += 3;
+
+  if (need > space && sink != NULL) {
+    Flush();
+    space = SQRL_TRACE_MASK;
+  }
+  if (need > space) {
+    if (lost < 0xffff) lost++;
+    if (lost_total < 0xffff) lost_total++;
+    return;
+  }
+
+  if (lost) {
+    Put(TRACE_LOST);
+    Put(lost & 0xff);
+    Put(lost >> 8);
+    lost = 0;
+  }
+  prev_time = now;
+  if (delta > TRACE_DELTA_MAX) {
+    if (delta > 0xffff) delta = 0xffff;
+    Put(dir | TRACE_DELTA_LONG);
+    Put(delta & 0xff);
+    Put(delta >> 8);
+  }
+  else Put(dir | (byte)delta);
+  Put(data);
+}
+
+/**********************************************************
+Method writes the records from the ring to the sink
+- to be called from the loop(), the AT engine calls it only
+  through Record() when the ring is full
+
+max_len: max. num. of bytes written by one call
+
+return: num. of bytes written
+**********************************************************/
+byte TraceStream::Flush(byte max_len)
+{
+  byte n = 0;
+
+  if (sink == NULL) return (0);
+  while (tail != head && n < max_len) {
+    sink->write(ring[tail]);
+    tail = (tail + 1) & SQRL_TRACE_MASK;
+    n++;
+  }
+  return (n);
+}
+
+int TraceStream::available(void)
+{
+  return port->available();
+}
+
+int TraceStream::read(void)
+{
+  int c = port->read();
+
+  if (c >= 0) Record(0, c);
+  return (c);
+}
+
+int TraceStream::peek(void)
+{
+  return port->peek();
+}
+
+void TraceStream::flush(void)
+{
+  port->flush();
+}
+
+size_t TraceStream::write(uint8_t c)
+{
+  size_t n = port->write(c);
+
+  if (n) Record(TRACE_TX, c);
+  return (n);
+}
+
+ReplayStream::ReplayStream(Stream &trace, byte replay_speed) {
+  source = &trace;
+  speed = replay_speed;
+  finished = 0;
+  mismatches = 0;
+  lost = 0;
+  prev_time = millis();
+  Next();
+}
+
+/**********************************************************
+Method reads the next record from the source, TRACE_LOST
+records are counted and skipped
+**********************************************************/
+void ReplayStream::Next(void)
+{
+  int b, lsb, msb;
+
+  while ((b = source->read()) >= 0) {
+    next_hdr = b;
+    if ((next_hdr & TRACE_DELTA_MASK) >= TRACE_DELTA_LONG) {
+      lsb = source->read();
+      msb = source->read();
+      if (lsb < 0 || msb < 0) break;
+      next_delta = lsb | (msb << 8);
+    }
+    else next_delta = next_hdr & TRACE_DELTA_MASK;
+
+    if ((next_hdr & TRACE_DELTA_MASK) == TRACE_LOST) {
+      lost += next_delta;
+      continue;
+    }
+    if ((b = source->read()) < 0) break;
+    next_data = b;
+    return;
+  }
+  finished = 1;
+}
+
+/**********************************************************
+Method checks if the next record is a received byte and its
+time has come
+**********************************************************/
+byte ReplayStream::IsRxDue(void)
+{
+  if (finished || (next_hdr & TRACE_TX)) return (0);
+  if (speed == 0) return (1);
+  return ((unsigned long)(millis() - prev_time) >= next_delta / speed);
+}
+
+int ReplayStream::available(void)
+{
+  return IsRxDue();
+}
+
+int ReplayStream::read(void)
+{
+  byte c;
+
+  if (!IsRxDue()) return (-1);
+  c = next_data;
+  // the time of the next byte is counted from the recorded time
+  // of this one, so a late read does not stretch the session
+  if (speed == 0) prev_time = millis();
+  else prev_time += next_delta / speed;
+  Next();
+  return (c);
+}
+
+int ReplayStream::peek(void)
+{
+  if (!IsRxDue()) return (-1);
+  return (next_data);
+}
+
+/**********************************************************
+Method matches the sent byte with the record, received bytes
+not read by the library yet are skipped so the replay keeps
+going when the library behaves differently than recorded
+**********************************************************/
+size_t ReplayStream::write(uint8_t c)
+{
+  byte skipped = 0;
+
+  while (!finished && !(next_hdr & TRACE_TX)) {
+    skipped = 1;
+    Next();
+  }
+  if (skipped || finished || next_data != c) {
+    if (mismatches < 0xffff) mismatches++;
+  }
+  if (finished) return (1);
+
+  prev_time = millis();
+  Next();
+  return (1);
+}
@@ -0,0 +1,131 @@
+/*
+sqrl_trace.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_TRACE_H
+#define __SQRL_TRACE_H
+
+#include "Arduino.h"
+
+/**********************************************************
+  Session trace and replay
+
+  TraceStream is put between AtComms and the UART of the
+  module and records every byte sent and received with the
+  time since the previous byte. Records are written into a
+  RAM ring, the ring is drained by Flush() from the loop()
+  to the sink (a Print, e.g. a File on the SD card). A full
+  ring is drained by the recording itself, so a slow sink
+  delays the AT engine (the UART buffers the received bytes
+  meanwhile) rather than losing the records.
+
+    TraceStream trace(Serial);
+    AtCommsBuffer<COMM_BUF_LEN> comms;
+    GSM gsm(comms);
+
+    comms.SetPort(&trace);
+    trace.Start(&trace_file);
+    ...
+    trace.Flush();              // in the loop()
+
+  ReplayStream feeds a recorded session back to AtComms in
+  place of the UART:
+  - received bytes become available after their recorded
+    delay divided by the speed (0 - no delay at all)
+  - the replay of the received bytes waits until the library
+    sends the bytes recorded as sent, the sent bytes are
+    compared with the record and the differences are counted
+  Replays faster than the original also shorten the gaps the
+  library waits for (timeouts), use speed 1 to reproduce them.
+  The replay reproduces the session only if no record was
+  lost (TraceStream::Lost() and ReplayStream::Lost() are 0).
+
+    ReplayStream replay(trace_file, 1);
+    comms.SetPort(&replay);
+
+  Record (binary):
+    <hdr><data>                 hdr = dir | delta (msec., 0..125)
+    <hdr><delta LSB><MSB><data> hdr = dir | TRACE_DELTA_LONG
+    <TRACE_LOST><LSB><MSB>      num. of records lost, the ring
+                                was full
+  The delta of a record after lost records includes their time.
+**********************************************************/
+
+// length of the ring, power of 2 up to 256
+#ifndef SQRL_TRACE_RING_LEN
+#define SQRL_TRACE_RING_LEN 128
+#endif
+
+// header of a record
+#define TRACE_TX            0x80    // byte was sent, 0 - received
+#define TRACE_DELTA_MASK    0x7f
+#define TRACE_DELTA_MAX     0x7d    // max. delta in the header
+#define TRACE_DELTA_LONG    0x7e    // 16-bit delta follows
+#define TRACE_LOST          0x7f    // 16-bit num. of lost records follows
+
+class TraceStream : public Stream {
+  private:
+    Stream *port;
+    byte ring[SQRL_TRACE_RING_LEN];
+    byte head;                      // written by Record() only
+    byte tail;                      // written by Flush() only
+    byte recording;
+    uint16_t lost;                  // records lost since the last TRACE_LOST
+    uint16_t lost_total;
+    unsigned long prev_time;        // time of the previous record
+    Print *sink;
+
+    void Put(byte b);
+    void Record(byte dir, byte data);
+
+  public:
+    TraceStream(Stream &stream);
+
+    void Start(Print *trace_sink);
+    inline void Stop(void) {recording = 0;};
+    byte Flush(byte max_len = 255);
+    inline uint16_t Lost(void) {return lost_total;};
+
+    // Stream
+    int available(void);
+    int read(void);
+    int peek(void);
+    void flush(void);
+    size_t write(uint8_t c);
+    using Print::write;
+};
+
+class ReplayStream : public Stream {
+  private:
+    Stream *source;                 // recorded session, e.g. a File
+    byte speed;                     // 1 - original, N - N times faster, 0 - no delays
+    byte next_hdr;                  // header of the next record
+    byte next_data;
+    uint16_t next_delta;
+    byte finished;
+    unsigned long prev_time;        // replay time of the previous record
+    uint16_t mismatches;
+    uint16_t lost;
+
+    void Next(void);
+    byte IsRxDue(void);
+
+  public:
+    ReplayStream(Stream &trace, byte replay_speed);
+
+    inline byte Finished(void) {return finished;};
+    inline uint16_t Mismatches(void) {return mismatches;};
+    inline uint16_t Lost(void) {return lost;};
+
+    // Stream
+    int available(void);
+    int read(void);
+    int peek(void);
+    void flush(void) {};
+    size_t write(uint8_t c);
+    using Print::write;
+};
+
+#endif
@@ -0,0 +1,326 @@
+/*
+sqrl_track.cpp
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#include "sqrl_track.h"
+#include "sqrl_geo.h"
+
+extern "C" {
+  #include <math.h>
+}
+
+// metres per 1e-5 deg. of latitude (mean Earth radius)
+#define TRACK_M_PER_E5      (EARTH_MEAN_RADIUS * DEG_TO_RAD * 0.00001)
+
+TrackRecorder::TrackRecorder(void) {
+  tolerance = TRACK_TOLERANCE;
+  max_gap = TRACK_MAX_GAP;
+  Clear();
+}
+
+/**********************************************************
+Method forgets the whole track, e.g. after the upload
+**********************************************************/
+void TrackRecorder::Clear(void) {
+  head = 0;
+  count = 0;
+  prev_valid = 0;
+  sector_valid = 0;
+}
+
+/**********************************************************
+Method stores the difference to the newest kept point
+- the oldest point is dropped if the ring is full
+**********************************************************/
+void TrackRecorder::Push(long dlat, long dlon, uint16_t dt)
+{
+  track_point_t *p;
+
+  if (count == TRACK_LEN) {
+    head = (head + 1) % TRACK_LEN;
+    p = &ring[head];
+    base_lat += p->dlat;
+    base_lon += p->dlon;
+    base_time += p->dt;
+    p->dlat = 0;
+    p->dlon = 0;
+    p->dt = 0;
+    count--;
+  }
+  p = &ring[(head + count) % TRACK_LEN];
+  p->dlat = dlat;
+  p->dlon = dlon;
+  p->dt = dt;
+  count++;
+}
+
+/**********************************************************
+Method keeps the point, it becomes the apex of a new sector
+- differences not fitting to 16 bits are split to more
+  points on the straight line
+**********************************************************/
+void TrackRecorder::Keep(long lat, long lon, unsigned long time)
+{
+  long dlat, dlon;
+  unsigned long dt;
+  unsigned long parts;
+  unsigned long n;
+
+  if (count == 0) {
+    base_lat = lat;
+    base_lon = lon;
+    base_time = time;
+    Push(0, 0, 0);
+  }
+  else {
+    dlat = lat - last_lat;
+    dlon = lon - last_lon;
+    dt = time - last_time;
+
+    parts = labs(dlat) / 32767;
+    if ((unsigned long)labs(dlon) / 32767 > parts) parts = labs(dlon) / 32767;
+    if (dt / 65535 > parts) parts = dt / 65535;
+    parts++;
+
+    for (n = 1; n < parts; n++) {
+      Push(dlat / (long)parts, dlon / (long)parts, dt / parts);
+    }
+    Push(dlat - (dlat / (long)parts) * (long)(parts - 1),
+         dlon - (dlon / (long)parts) * (long)(parts - 1),
+         dt - (dt / parts) * (parts - 1));
+  }
+
+  last_lat = lat;
+  last_lon = lon;
+  last_time = time;
+  last_cos = cos(lat * (DEG_TO_RAD * 0.00001));
+  prev_valid = 0;
+  sector_valid = 0;
+}
+
+/**********************************************************
+Method narrows the sector by the fix
+- the straight line from the apex to any direction inside
+  the sector passes all the fixes since the apex within the
+  tolerance
+- fixes within the tolerance from the apex do not narrow it
+
+return: 1 - fix is inside the sector, it can end the line
+        0 - fix is outside the sector
+**********************************************************/
+byte TrackRecorder::Narrow(long lat, long lon)
+{
+  double x = (lon - last_lon) * (TRACK_M_PER_E5 * last_cos);
+  double y = (lat - last_lat) * TRACK_M_PER_E5;
+  double d = sqrt(x * x + y * y);
+  double dir, half, off;
+
+  if (d <= tolerance) return (1);
+
+  dir = atan2(y, x);
+  half = asin(tolerance / d);
+
+  if (!sector_valid) {
+    sector_dir = dir;
+    sector_lo = -half;
+    sector_hi = half;
+    sector_valid = 1;
+    return (1);
+  }
+
+  off = dir - sector_dir;
+  if (off > M_PI) off -= 2 * M_PI;
+  else if (off < -M_PI) off += 2 * M_PI;
+  if (off < sector_lo || off > sector_hi) return (0);
+
+  if (off - half > sector_lo) sector_lo = off - half;
+  if (off + half < sector_hi) sector_hi = off + half;
+  return (1);
+}
+
+/**********************************************************
+Method adds the received fix to the track
+
+pos:  position of the fix
+time: time of the fix in sec. (e.g. millis()/1000 or the
+      GPS time), must not go back
+**********************************************************/
+void TrackRecorder::Add(const position_e6_t &pos, unsigned long time)
+{
+  // 1e-6 deg. --> 1e-5 deg. rounded
+  long lat = (pos.lat >= 0 ? pos.lat + 5 : pos.lat - 5) / 10;
+  long lon = (pos.lon >= 0 ? pos.lon + 5 : pos.lon - 5) / 10;
+
+  if (count == 0) {
+    Keep(lat, lon, time);
+    return;
+  }
+
+  if (!prev_valid) {
+    // first fix after the apex, it seeds the sector
+    Narrow(lat, lon);
+  }
+  else if (time - last_time > max_gap || !Narrow(lat, lon)) {
+    // the previous fix was the last one the straight line
+    // from the apex was good enough for
+    Keep(prev_lat, prev_lon, prev_time);
+    Narrow(lat, lon);
+  }
+
+  prev_lat = lat;
+  prev_lon = lon;
+  prev_time = time;
+  prev_valid = 1;
+}
+
+// appends one value of the encoded polyline
+static byte TrackPutPolyline(char *buf, uint16_t &len, uint16_t max_len, long value)
+{
+  unsigned long v = (value < 0) ? ~((unsigned long)value << 1) : ((unsigned long)value << 1);
+
+  do {
+    if (len >= max_len) return (0);
+    buf[len++] = (v >= 0x20) ? (((v & 0x1f) | 0x20) + 63) : (v + 63);
+    v >>= 5;
+  } while (v);
+  return (1);
+}
+
+/**********************************************************
+Method serialises the track as the encoded polyline with
+precision 5 (the format of the Google Maps API)
+
+buf:     filled by the polyline finished by 0x00
+max_len: size of the buffer including 0x00
+
+return: num. of characters, 0 - empty track or the track
+        does not fit to the buffer
+**********************************************************/
+uint16_t TrackRecorder::EncodePolyline(char *buf, uint16_t max_len)
+{
+  uint16_t len = 0;
+  byte i;
+  const track_point_t *p;
+  long lat, lon;
+
+  if (count == 0 || max_len == 0) return (0);
+  max_len--;
+
+  if (!TrackPutPolyline(buf, len, max_len, base_lat)) return (0);
+  if (!TrackPutPolyline(buf, len, max_len, base_lon)) return (0);
+  for (i = 1; i < count; i++) {
+    p = &ring[(head + i) % TRACK_LEN];
+    if (!TrackPutPolyline(buf, len, max_len, p->dlat)) return (0);
+    if (!TrackPutPolyline(buf, len, max_len, p->dlon)) return (0);
+  }
+  if (prev_valid) {
+    lat = prev_lat - last_lat;
+    lon = prev_lon - last_lon;
+    if (!TrackPutPolyline(buf, len, max_len, lat)) return (0);
+    if (!TrackPutPolyline(buf, len, max_len, lon)) return (0);
+  }
+  buf[len] = 0;
+  return (len);
+}
+
+// appends one varint (7 bits per byte, LSB first)
+static byte TrackPutVarint(byte *buf, uint16_t &len, uint16_t max_len, unsigned long v)
+{
+  do {
+    if (len >= max_len) return (0);
+    buf[len++] = (v >= 0x80) ? ((v & 0x7f) | 0x80) : v;
+    v >>= 7;
+  } while (v);
+  return (1);
+}
+
+// zigzag - small negative values are small too
+static inline unsigned long TrackZigzag(long v)
+{
+  return ((unsigned long)v << 1) ^ (unsigned long)(v >> 31);
+}
+
+/**********************************************************
+Method serialises the track as the binary varint stream
+(see TrackRecorder), see TrackDecodeBinary()
+
+return: num. of bytes, 0 - empty track or the track does not
+        fit to the buffer
+**********************************************************/
+uint16_t TrackRecorder::EncodeBinary(byte *buf, uint16_t max_len)
+{
+  uint16_t len = 0;
+  byte i;
+  const track_point_t *p;
+
+  if (count == 0) return (0);
+
+  if (!TrackPutVarint(buf, len, max_len, base_time)) return (0);
+  if (!TrackPutVarint(buf, len, max_len, TrackZigzag(base_lat))) return (0);
+  if (!TrackPutVarint(buf, len, max_len, TrackZigzag(base_lon))) return (0);
+  for (i = 1; i < count; i++) {
+    p = &ring[(head + i) % TRACK_LEN];
+    if (!TrackPutVarint(buf, len, max_len, TrackZigzag(p->dlat))) return (0);
+    if (!TrackPutVarint(buf, len, max_len, TrackZigzag(p->dlon))) return (0);
+    if (!TrackPutVarint(buf, len, max_len, p->dt)) return (0);
+  }
+  if (prev_valid) {
+    if (!TrackPutVarint(buf, len, max_len, TrackZigzag(prev_lat - last_lat))) return (0);
+    if (!TrackPutVarint(buf, len, max_len, TrackZigzag(prev_lon - last_lon))) return (0);
+    if (!TrackPutVarint(buf, len, max_len, prev_time - last_time)) return (0);
+  }
+  return (len);
+}
+
+// reads one varint, NULL - stream is cut
+static const byte *TrackGetVarint(const byte *p, const byte *end, unsigned long &v)
+{
+  byte shift = 0;
+
+  v = 0;
+  while (p < end) {
+    v |= (unsigned long)(*p & 0x7f) << shift;
+    if (!(*p++ & 0x80)) return (p);
+    shift += 7;
+  }
+  return (NULL);
+}
+
+/**********************************************************
+Function decodes the stream made by EncodeBinary()
+
+pos:        filled by positions in 1e-6 deg.
+time:       filled by times in sec., can be NULL
+max_points: size of the arrays
+
+return: num. of decoded points
+**********************************************************/
+uint16_t TrackDecodeBinary(const byte *in, uint16_t in_len, position_e6_t *pos, unsigned long *time, uint16_t max_points)
+{
+  const byte *end = in + in_len;
+  unsigned long t, zlat, zlon, v;
+  long lat = 0, lon = 0;
+  uint16_t n = 0;
+
+  in = TrackGetVarint(in, end, t);
+  if (in != NULL) in = TrackGetVarint(in, end, zlat);
+  if (in != NULL) in = TrackGetVarint(in, end, zlon);
+
+  while (in != NULL && n < max_points) {
+    lat += (long)(zlat >> 1) ^ -(long)(zlat & 1);
+    lon += (long)(zlon >> 1) ^ -(long)(zlon & 1);
+    pos[n].lat = lat * 10;
+    pos[n].lon = lon * 10;
+    if (time != NULL) time[n] = t;
+    n++;
+
+    if (in >= end) break;
+    in = TrackGetVarint(in, end, zlat);
+    if (in != NULL) in = TrackGetVarint(in, end, zlon);
+    if (in != NULL) in = TrackGetVarint(in, end, v);
+    t += v;
+  }
+  return (n);
+}
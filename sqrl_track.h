@@ -0,0 +1,99 @@
+/*
+sqrl_track.h
+Copyright (c) www.hwkitchen.com and contributors @jgarland79, @harlequin-tech, @scott-abernethy.
+This file is part of sqrl, the squirt-library. Please refer to the NOTICE.txt file for license details.
+*/
+
+#ifndef __SQRL_TRACK_H
+#define __SQRL_TRACK_H
+
+#include "Arduino.h"
+#include "sqrl_gps.h"
+
+// num. of points kept in the track ring (6 bytes per point)
+#define TRACK_LEN           64
+// default max. distance of a dropped fix from the track (metres)
+#define TRACK_TOLERANCE     10
+// default max. time between two kept points (sec.)
+#define TRACK_MAX_GAP       300
+
+// kept point as the difference to the previous one
+struct track_point_t {
+  int16_t dlat;       // in 1e-5 deg. (approx. 1.1 m)
+  int16_t dlon;
+  uint16_t dt;        // sec.
+};
+
+/**********************************************************
+  Track recorder
+
+  Fixes are simplified online by the sector method (streaming
+  form of Douglas-Peucker): a fix is kept only when the track
+  cannot go straight from the last kept point to the newest
+  fix without leaving some of the fixes in between further
+  than the tolerance. Instead of keeping the fixes in between,
+  every fix narrows the sector of directions from the last
+  kept point the track may continue in, so the memory does
+  not grow with the length of a straight segment.
+
+  Kept points are stored as 16 bit differences in 1e-5 deg.
+  and the time difference in a ring of TRACK_LEN points, the
+  oldest point is dropped when the ring is full.
+
+  The track is serialised either as the encoded polyline
+  (precision 5, ASCII, e.g. for a URL) or as the binary
+  stream of zigzag varints:
+    <time><lat><lon> of the first point, then
+    <dlat><dlon><dt> for every next point
+  The newest received fix is always included as the last
+  point, so the serialised track ends at the current
+  position.
+**********************************************************/
+class TrackRecorder {
+  private:
+    track_point_t ring[TRACK_LEN];
+    byte head;                  // index of the oldest point
+    byte count;                 // num. of kept points
+
+    long base_lat;              // oldest kept point in 1e-5 deg.
+    long base_lon;
+    unsigned long base_time;
+
+    long last_lat;              // newest kept point - the apex
+    long last_lon;              // of the sector
+    unsigned long last_time;
+    double last_cos;            // cos(last_lat)
+
+    long prev_lat;              // newest received fix, not kept
+    long prev_lon;
+    unsigned long prev_time;
+    byte prev_valid;
+
+    double sector_dir;          // axis of the sector (radians)
+    double sector_lo;           // allowed directions relative
+    double sector_hi;           // to the axis
+    byte sector_valid;
+
+    uint16_t tolerance;
+    uint16_t max_gap;
+
+    void Keep(long lat, long lon, unsigned long time);
+    void Push(long dlat, long dlon, uint16_t dt);
+    byte Narrow(long lat, long lon);
+
+  public:
+    TrackRecorder(void);
+
+    void Clear(void);
+    void Add(const position_e6_t &pos, unsigned long time);
+    inline void SetTolerance(uint16_t metres) {tolerance = metres;};
+    inline void SetMaxGap(uint16_t sec) {max_gap = sec;};
+    inline byte GetCount(void) {return count;};
+
+    uint16_t EncodePolyline(char *buf, uint16_t max_len);
+    uint16_t EncodeBinary(byte *buf, uint16_t max_len);
+};
+
+uint16_t TrackDecodeBinary(const byte *in, uint16_t in_len, position_e6_t *pos, unsigned long *time, uint16_t max_points);
+
+#endif